@@ -0,0 +1,76 @@
+#include <sos/sharded_store.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mgb;
+
+namespace {
+
+constexpr int ops_per_thread = 1'000'000;
+constexpr int live_per_thread = 16;
+
+struct Payload {
+	int value;
+	Payload(int v) : value(v) {}
+};
+
+// Returns create+release pairs per second over all threads
+template<class Store>
+double run(int thread_cnt)
+{
+	auto store = std::make_unique<Store>();
+
+	std::atomic_int ready{ 0 };
+	std::atomic_bool go{ false };
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_cnt; ++t) {
+		threads.emplace_back([&] {
+			std::vector<sos::Handle<Payload>> handles(live_per_thread);
+			ready++;
+			while (!go) {
+				std::this_thread::yield();
+			}
+			for (int i = 0; i < ops_per_thread; ++i) {
+				handles[i % live_per_thread] = store->create(i);
+			}
+		});
+	}
+	while (ready != thread_cnt) {
+		std::this_thread::yield();
+	}
+	const auto start = std::chrono::steady_clock::now();
+	go = true;
+	for (auto& t : threads) {
+		t.join();
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return static_cast<double>(ops_per_thread) * thread_cnt / elapsed.count();
+}
+
+} // namespace
+
+int main()
+{
+	constexpr sos::idx_t capacity = 1 << 16;
+	using GlobalStore   = sos::SharedObjectStore<Payload, capacity>;
+	using MagazineStore = sos::SharedObjectStore<Payload, capacity, sos::alloc::magazines<>>;
+	using ShardedStore  = sos::ShardedObjectStore<Payload, capacity / 16>;
+
+	const int max_threads = static_cast<int>(std::max(2u, std::thread::hardware_concurrency()) * 2);
+
+	std::cout << "create/release throughput [Mops/s]\n";
+	std::cout << std::setw(8) << "threads" << std::setw(14) << "free_list" << std::setw(14) << "magazines" << std::setw(14) << "sharded" << '\n';
+	for (int threads = 1; threads <= max_threads; threads *= 2) {
+		std::cout << std::setw(8) << threads
+				  << std::setw(14) << std::fixed << std::setprecision(2) << run<GlobalStore>(threads) / 1e6
+				  << std::setw(14) << run<MagazineStore>(threads) / 1e6
+				  << std::setw(14) << run<ShardedStore>(threads) / 1e6 << std::endl;
+	}
+}
@@ -0,0 +1,67 @@
+#include <sos/sos.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace mgb;
+
+namespace {
+
+constexpr int copies_per_thread = 2'000'000;
+
+// All threads keep copying and dropping handles to one shared object. Returns copy+drop pairs per second
+template<class Store>
+double run(int thread_cnt)
+{
+	auto store = std::make_unique<Store>();
+	const auto hot = std::move(store->create(1)).lock();
+
+	std::atomic_bool go{ false };
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_cnt; ++t) {
+		threads.emplace_back([&] {
+			while (!go) {
+				std::this_thread::yield();
+			}
+			int sum = 0;
+			for (int i = 0; i < copies_per_thread; ++i) {
+				auto copy = hot;
+				sum += *copy;
+			}
+			if (sum != copies_per_thread) {
+				std::abort();
+			}
+		});
+	}
+	const auto start = std::chrono::steady_clock::now();
+	go = true;
+	for (auto& t : threads) {
+		t.join();
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return static_cast<double>(copies_per_thread) * thread_cnt / elapsed.count();
+}
+
+} // namespace
+
+int main()
+{
+	using AtomicStore = sos::SharedObjectStore<int, 16>;
+	using BiasedStore = sos::SharedObjectStore<int, 16, sos::refcount::biased<>>;
+
+	const int max_threads = static_cast<int>(std::max(2u, std::thread::hardware_concurrency()));
+
+	std::cout << "copy/drop of a handle to one hot object [Mops/s]\n";
+	std::cout << std::setw(8) << "threads" << std::setw(14) << "atomic" << std::setw(14) << "biased" << '\n';
+	for (int threads = 1; threads <= max_threads; threads *= 2) {
+		std::cout << std::setw(8) << threads << std::fixed << std::setprecision(2)
+				  << std::setw(14) << run<AtomicStore>(threads) / 1e6
+				  << std::setw(14) << run<BiasedStore>(threads) / 1e6 << std::endl;
+	}
+}
@@ -0,0 +1,80 @@
+#include <sos/sos.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace mgb;
+
+namespace {
+
+constexpr int copies_per_thread = 2'000'000;
+
+// Every thread copies and destroys a ConstHandle to "its" object. The objects are created back to back,
+// so with the interleaved layout the refcounts of neighbouring threads share cache lines.
+// Returns copy+destroy pairs per second over all threads
+template<class Store>
+double run(int thread_cnt)
+{
+	auto store = std::make_unique<Store>();
+
+	std::vector<typename Store::const_handle_type> objects;
+	for (int t = 0; t < thread_cnt; ++t) {
+		objects.push_back(store->create(t).lock());
+	}
+
+	std::atomic_int ready{ 0 };
+	std::atomic_bool go{ false };
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_cnt; ++t) {
+		threads.emplace_back([&, t] {
+			const auto& mine = objects[t];
+			ready++;
+			while (!go) {
+				std::this_thread::yield();
+			}
+			for (int i = 0; i < copies_per_thread; ++i) {
+				auto copy = mine;
+				if (*copy != t) {
+					std::terminate();
+				}
+			}
+		});
+	}
+	while (ready != thread_cnt) {
+		std::this_thread::yield();
+	}
+	const auto start = std::chrono::steady_clock::now();
+	go = true;
+	for (auto& t : threads) {
+		t.join();
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return static_cast<double>(copies_per_thread) * thread_cnt / elapsed.count();
+}
+
+} // namespace
+
+int main()
+{
+	constexpr sos::idx_t capacity = 1024;
+	using Interleaved = sos::SharedObjectStore<int, capacity>;
+	using SplitPadded = sos::SharedObjectStore<int, capacity, sos::layout::split<1>>;
+	using SplitGroup4 = sos::SharedObjectStore<int, capacity, sos::layout::split<4>>;
+
+	const int max_threads = static_cast<int>(std::max(2u, std::thread::hardware_concurrency()));
+
+	std::cout << "ConstHandle copy/destroy throughput [Mops/s]\n";
+	std::cout << std::setw(8) << "threads" << std::setw(14) << "interleaved" << std::setw(14) << "split<1>" << std::setw(14) << "split<4>" << '\n';
+	for (int threads = 1; threads <= max_threads; threads *= 2) {
+		std::cout << std::setw(8) << threads
+				  << std::setw(14) << std::fixed << std::setprecision(2) << run<Interleaved>(threads) / 1e6
+				  << std::setw(14) << run<SplitPadded>(threads) / 1e6
+				  << std::setw(14) << run<SplitGroup4>(threads) / 1e6 << std::endl;
+	}
+}
@@ -0,0 +1,158 @@
+#include <sos/handle_queue.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace mgb;
+
+namespace {
+
+constexpr int items_per_producer = 500'000;
+constexpr int batch_size         = 16;
+
+using Store  = sos::SharedObjectStore<int, 1 << 16>;
+using Handle = Store::const_handle_type;
+
+// What the pipelines used so far: a std::deque guarded by a mutex, which copies the handle in and out
+class MutexQueue {
+public:
+	bool try_push(const Handle& h)
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		items.push_back(h);
+		return true;
+	}
+	Handle try_pop()
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		if (items.empty()) {
+			return {};
+		}
+		auto h = items.front();
+		items.pop_front();
+		return h;
+	}
+
+private:
+	std::mutex         mtx;
+	std::deque<Handle> items;
+};
+
+// Every producer pushes the same few objects over and over, consumers pop until everything arrived.
+// Returns transferred handles per second
+template<class Push, class Pop>
+double run(int pairs, Push push, Pop pop)
+{
+	std::atomic_int  consumed{ 0 };
+	std::atomic_bool go{ false };
+	const int        total = pairs * items_per_producer;
+
+	std::vector<std::thread> threads;
+	for (int p = 0; p < pairs; ++p) {
+		threads.emplace_back([&] {
+			while (!go) {
+				std::this_thread::yield();
+			}
+			for (int i = 0; i < items_per_producer; i += batch_size) {
+				push(std::min(batch_size, items_per_producer - i));
+			}
+		});
+		threads.emplace_back([&] {
+			while (!go) {
+				std::this_thread::yield();
+			}
+			while (consumed.load(std::memory_order_relaxed) < total) {
+				const int n = pop();
+				if (n == 0) {
+					std::this_thread::yield();
+				}
+				consumed.fetch_add(n, std::memory_order_relaxed);
+			}
+		});
+	}
+	const auto start = std::chrono::steady_clock::now();
+	go = true;
+	for (auto& t : threads) {
+		t.join();
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return total / elapsed.count();
+}
+
+double run_mutex(Store& store, int pairs)
+{
+	MutexQueue queue;
+	const auto obj = std::move(store.create(1)).lock();
+	return run(
+		pairs,
+		[&](int n) {
+			for (int i = 0; i < n; ++i) {
+				queue.try_push(obj);
+			}
+		},
+		[&] {
+			int n = 0;
+			while (n < batch_size && !queue.try_pop().empty()) {
+				++n;
+			}
+			return n;
+		});
+}
+
+double run_lock_free(Store& store, int pairs, bool batched)
+{
+	sos::HandleQueue<Store> queue(store, 4096);
+	const auto obj = std::move(store.create(1)).lock();
+	return run(
+		pairs,
+		[&](int n) {
+			Handle batch[batch_size];
+			for (int i = 0; i < n; ++i) {
+				batch[i] = obj;
+			}
+			for (int pushed = 0; pushed < n;) {
+				const auto cnt = batched ? queue.try_push_n(batch + pushed, static_cast<std::size_t>(n - pushed))
+										 : static_cast<std::size_t>(queue.try_push(std::move(batch[pushed])));
+				if (cnt == 0) {
+					std::this_thread::yield();
+				}
+				pushed += static_cast<int>(cnt);
+			}
+		},
+		[&] {
+			Handle batch[batch_size];
+			if (batched) {
+				return static_cast<int>(queue.try_pop_n(batch, batch_size));
+			}
+			int n = 0;
+			while (n < batch_size && !(batch[n] = queue.try_pop()).empty()) {
+				++n;
+			}
+			return n;
+		});
+}
+
+} // namespace
+
+int main()
+{
+	auto store = std::make_unique<Store>();
+
+	const int max_pairs = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+	std::cout << "handle transfer throughput [Mhandles/s]\n";
+	std::cout << std::setw(8) << "pairs" << std::setw(14) << "mutex-deque" << std::setw(14) << "lock-free" << std::setw(14) << "batched" << '\n';
+	for (int pairs = 1; pairs <= max_pairs; pairs *= 2) {
+		std::cout << std::setw(8) << pairs << std::fixed << std::setprecision(2)
+				  << std::setw(14) << run_mutex(*store, pairs) / 1e6
+				  << std::setw(14) << run_lock_free(*store, pairs, false) / 1e6
+				  << std::setw(14) << run_lock_free(*store, pairs, true) / 1e6 << std::endl;
+	}
+}
@@ -0,0 +1,440 @@
+/*
+ * sos-bench: throughput of the basic store operations next to the usual alternatives
+ * (std::make_shared, new/delete and a mutex guarded pool).
+ *
+ * usage: sos-bench [--format=table|csv|json] [--filter=<substring>] [--reps=<n>] [--quick]
+ *
+ * Every result is the best of --reps runs. csv and json are meant for tracking regressions across releases
+ * (one row/object per measurement, keyed by benchmark, subject, threads and param).
+ */
+#include <sos/sos.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using namespace mgb;
+
+namespace {
+
+constexpr sos::idx_t capacity        = 1 << 16;
+constexpr int        live_per_thread = 16;
+
+struct Payload {
+	int value;
+	Payload(int v) : value(v) {}
+};
+
+using DefaultStore  = sos::SharedObjectStore<Payload, capacity>;
+using MagazineStore = sos::SharedObjectStore<Payload, capacity, sos::alloc::magazines<>>;
+using BitmapStore   = sos::SharedObjectStore<Payload, capacity, sos::alloc::bitmap>;
+using BiasedStore   = sos::SharedObjectStore<Payload, capacity, sos::refcount::biased<>>;
+using StatsStore    = sos::SharedObjectStore<Payload, capacity, sos::stats::counters<>>;
+
+std::atomic<long> sink{ 0 };
+
+// ---- subjects -------------------------------------------------------------------------------------------------
+
+template<class Store>
+struct StoreSubject {
+	using handle_type = typename Store::handle_type;
+
+	std::unique_ptr<Store> store = std::make_unique<Store>();
+
+	handle_type make(int v) { return store->create(v); }
+};
+
+struct SharedPtrSubject {
+	using handle_type = std::shared_ptr<Payload>;
+
+	handle_type make(int v) { return std::make_shared<Payload>(v); }
+};
+
+struct NewDeleteSubject {
+	using handle_type = std::unique_ptr<Payload>;
+
+	handle_type make(int v) { return handle_type(new Payload(v)); }
+};
+
+// fixed capacity pool with a free list guarded by a std::mutex
+class MutexPool {
+	struct Deleter {
+		MutexPool* pool;
+		void operator()(Payload* p) const noexcept { pool->destroy(p); }
+	};
+	using storage_type = std::aligned_storage_t<sizeof(Payload), alignof(Payload)>;
+
+public:
+	using handle_type = std::unique_ptr<Payload, Deleter>;
+
+	MutexPool()
+		: storage(new storage_type[capacity])
+	{
+		free.reserve(capacity);
+		for (sos::idx_t i = capacity; i > 0; --i) {
+			free.push_back(&storage[i - 1]);
+		}
+	}
+
+	handle_type make(int v)
+	{
+		void* mem = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (free.empty()) {
+				throw std::bad_alloc();
+			}
+			mem = free.back();
+			free.pop_back();
+		}
+		return handle_type(new (mem) Payload(v), Deleter{ this });
+	}
+
+private:
+	std::unique_ptr<storage_type[]> storage;
+	std::vector<storage_type*>      free;
+	std::mutex                      mtx;
+
+	void destroy(Payload* p) noexcept
+	{
+		p->~Payload();
+		std::lock_guard<std::mutex> lock(mtx);
+		free.push_back(reinterpret_cast<storage_type*>(p));
+	}
+};
+
+// ---- harness --------------------------------------------------------------------------------------------------
+
+struct Result {
+	std::string benchmark;
+	std::string subject;
+	int         threads;
+	int         param;
+	double      ops_per_sec;
+};
+
+struct Options {
+	std::string format = "table";
+	std::string filter;
+	int         reps = 3;
+	long        ops  = 1'000'000;
+};
+
+Options             options;
+std::vector<Result> results;
+
+// Runs body(thread_idx, ops) on thread_cnt threads that start at the same time and returns the total ops per second
+double run_threads(int thread_cnt, long ops, const std::function<void(int, long)>& body)
+{
+	std::atomic_int          ready{ 0 };
+	std::atomic_bool         go{ false };
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_cnt; ++t) {
+		threads.emplace_back([&, t] {
+			ready++;
+			while (!go) {
+				std::this_thread::yield();
+			}
+			body(t, ops);
+		});
+	}
+	while (ready != thread_cnt) {
+		std::this_thread::yield();
+	}
+	const auto start = std::chrono::steady_clock::now();
+	go               = true;
+	for (auto& t : threads) {
+		t.join();
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return static_cast<double>(ops) * thread_cnt / elapsed.count();
+}
+
+// setup() creates a fresh fixture and returns the body that gets measured on it (the fixture lives in the closure)
+void measure(const std::string& benchmark, const std::string& subject, int threads, int param, long ops,
+			 const std::function<std::function<void(int, long)>()>& setup)
+{
+	const auto name = benchmark + "/" + subject;
+	if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+		return;
+	}
+	double best = 0;
+	for (int r = 0; r < options.reps; ++r) {
+		const auto body = setup();
+		best            = std::max(best, run_threads(threads, ops, body));
+	}
+	results.push_back({ benchmark, subject, threads, param, best });
+	if (options.format == "table") {
+		std::cout << std::left << std::setw(24) << benchmark << std::setw(16) << subject << std::right << std::setw(8)
+				  << threads << std::setw(8) << param << std::fixed << std::setprecision(2) << std::setw(14)
+				  << best / 1e6 << std::setw(12) << 1e9 / best << std::endl;
+	}
+}
+
+std::vector<int> thread_counts()
+{
+	const int        max_threads = static_cast<int>(std::max(2u, std::thread::hardware_concurrency()));
+	std::vector<int> counts;
+	for (int t = 1; t <= max_threads; t *= 2) {
+		counts.push_back(t);
+	}
+	return counts;
+}
+
+// ---- benchmarks -----------------------------------------------------------------------------------------------
+
+// single threaded create/destroy of one object while occupancy percent of the capacity is in use
+template<class Subject>
+void create_destroy(const std::string& name, int occupancy)
+{
+	measure("create_destroy", name, 1, occupancy, options.ops, [occupancy] {
+		struct Fixture {
+			Subject                                    subject;
+			std::vector<typename Subject::handle_type> held;
+		};
+		auto f = std::make_shared<Fixture>();
+		for (sos::idx_t i = 0; i < capacity / 100 * static_cast<sos::idx_t>(occupancy); ++i) {
+			f->held.push_back(f->subject.make(static_cast<int>(i)));
+		}
+		return [f](int, long ops) {
+			long sum = 0;
+			for (long i = 0; i < ops; ++i) {
+				auto h = f->subject.make(static_cast<int>(i));
+				sum += h->value;
+			}
+			sink += sum;
+		};
+	});
+}
+
+// every thread keeps a ring of live_per_thread objects and replaces one of them per operation
+template<class Subject>
+void create_destroy_mt(const std::string& name, int threads)
+{
+	measure("create_destroy_mt", name, threads, live_per_thread, options.ops, [] {
+		auto subject = std::make_shared<Subject>();
+		return [subject](int, long ops) {
+			std::vector<typename Subject::handle_type> ring(live_per_thread);
+			for (long i = 0; i < ops; ++i) {
+				ring[static_cast<std::size_t>(i % live_per_thread)] = subject->make(static_cast<int>(i));
+			}
+		};
+	});
+}
+
+// all threads copy and drop handles to one shared object
+template<class Subject, class MakeShared>
+void copy_contended(const std::string& name, int threads, MakeShared make_shared)
+{
+	measure("copy_contended", name, threads, 0, options.ops, [make_shared] {
+		struct Fixture {
+			Subject                                         subject;
+			decltype(make_shared(std::declval<Subject&>())) hot;
+		};
+		auto f = std::make_shared<Fixture>();
+		f->hot = make_shared(f->subject);
+		return [f](int, long ops) {
+			long sum = 0;
+			for (long i = 0; i < ops; ++i) {
+				auto copy = f->hot;
+				sum += copy->value;
+			}
+			sink += sum;
+		};
+	});
+}
+
+// modifiable -> const -> modifiable round trip of a unique handle
+void lock_round_trip()
+{
+	measure("lock_round_trip", "sos", 1, 0, options.ops, [] {
+		auto store = std::make_shared<StoreSubject<DefaultStore>>();
+		return [store](int, long ops) {
+			auto handle = store->make(0);
+			for (long i = 0; i < ops; ++i) {
+				auto locked = std::move(handle).lock();
+				handle      = std::move(locked).turn_into_modifiable_handle();
+				handle->value++;
+			}
+			sink += handle->value;
+		};
+	});
+	// closest std equivalent: shared_ptr<T> -> shared_ptr<const T> and back after checking for uniqueness
+	measure("lock_round_trip", "shared_ptr", 1, 0, options.ops, [] {
+		return [](int, long ops) {
+			auto handle = std::make_shared<Payload>(0);
+			for (long i = 0; i < ops; ++i) {
+				std::shared_ptr<const Payload> locked = std::move(handle);
+				if (locked.use_count() != 1) {
+					std::abort();
+				}
+				handle = std::const_pointer_cast<Payload>(std::move(locked));
+				handle->value++;
+			}
+			sink += handle->value;
+		};
+	});
+}
+
+// cost of a single live_objects_approx() call on a half full store
+template<class Store>
+void live_objects(const std::string& name)
+{
+	measure("live_objects_approx", name, 1, 50, options.ops, [] {
+		struct Fixture {
+			Store                                    store;
+			std::vector<typename Store::handle_type> held;
+		};
+		auto f = std::make_shared<Fixture>();
+		for (sos::idx_t i = 0; i < capacity / 2; ++i) {
+			f->held.push_back(f->store.create(static_cast<int>(i)));
+		}
+		return [f](int, long ops) {
+			long sum = 0;
+			for (long i = 0; i < ops; ++i) {
+				sum += static_cast<long>(f->store.live_objects_approx());
+			}
+			sink += sum;
+		};
+	});
+}
+
+// ---- output ---------------------------------------------------------------------------------------------------
+
+const char* compiler()
+{
+#if defined(__clang__)
+	return "clang " __clang_version__;
+#elif defined(__GNUC__)
+	return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+	return "msvc";
+#else
+	return "unknown";
+#endif
+}
+
+std::string escape(const std::string& s)
+{
+	std::string out;
+	for (char c : s) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+		}
+		out += c;
+	}
+	return out;
+}
+
+void print_csv()
+{
+	std::cout << "benchmark,subject,threads,param,ops_per_sec,ns_per_op\n";
+	for (const auto& r : results) {
+		std::cout << r.benchmark << ',' << r.subject << ',' << r.threads << ',' << r.param << ',' << std::fixed
+				  << std::setprecision(0) << r.ops_per_sec << ',' << std::setprecision(3) << 1e9 / r.ops_per_sec
+				  << '\n';
+	}
+}
+
+void print_json()
+{
+	std::cout << "{\n";
+	std::cout << "  \"context\": {\"compiler\": \"" << escape(compiler()) << "\", \"hardware_concurrency\": "
+			  << std::thread::hardware_concurrency() << ", \"ndebug\": "
+#ifdef NDEBUG
+			  << "true"
+#else
+			  << "false"
+#endif
+			  << ", \"reps\": " << options.reps << ", \"ops\": " << options.ops << "},\n";
+	std::cout << "  \"benchmarks\": [";
+	for (std::size_t i = 0; i < results.size(); ++i) {
+		const auto& r = results[i];
+		std::cout << (i ? ",\n" : "\n") << "    {\"benchmark\": \"" << r.benchmark << "\", \"subject\": \"" << r.subject
+				  << "\", \"threads\": " << r.threads << ", \"param\": " << r.param << ", \"ops_per_sec\": "
+				  << std::fixed << std::setprecision(0) << r.ops_per_sec << ", \"ns_per_op\": "
+				  << std::setprecision(3) << 1e9 / r.ops_per_sec << "}";
+	}
+	std::cout << "\n  ]\n}\n";
+}
+
+bool parse(int argc, char** argv)
+{
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg.rfind("--format=", 0) == 0) {
+			options.format = arg.substr(9);
+		} else if (arg.rfind("--filter=", 0) == 0) {
+			options.filter = arg.substr(9);
+		} else if (arg.rfind("--reps=", 0) == 0) {
+			options.reps = std::max(1, std::atoi(arg.c_str() + 7));
+		} else if (arg == "--quick") {
+			options.ops /= 20;
+			options.reps = 1;
+		} else {
+			return false;
+		}
+	}
+	return options.format == "table" || options.format == "csv" || options.format == "json";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	if (!parse(argc, argv)) {
+		std::cerr << "usage: sos-bench [--format=table|csv|json] [--filter=<substring>] [--reps=<n>] [--quick]\n";
+		return 1;
+	}
+	if (options.format == "table") {
+		std::cout << std::left << std::setw(24) << "benchmark" << std::setw(16) << "subject" << std::right
+				  << std::setw(8) << "threads" << std::setw(8) << "param" << std::setw(14) << "Mops/s" << std::setw(12)
+				  << "ns/op" << '\n';
+	}
+
+	for (int occupancy : { 0, 50, 90, 99 }) {
+		create_destroy<StoreSubject<DefaultStore>>("sos", occupancy);
+		create_destroy<StoreSubject<BitmapStore>>("sos_bitmap", occupancy);
+		create_destroy<SharedPtrSubject>("make_shared", occupancy);
+		create_destroy<NewDeleteSubject>("new_delete", occupancy);
+		create_destroy<MutexPool>("mutex_pool", occupancy);
+	}
+
+	for (int threads : thread_counts()) {
+		create_destroy_mt<StoreSubject<DefaultStore>>("sos", threads);
+		create_destroy_mt<StoreSubject<MagazineStore>>("sos_magazines", threads);
+		create_destroy_mt<StoreSubject<StatsStore>>("sos_stats", threads);
+		create_destroy_mt<SharedPtrSubject>("make_shared", threads);
+		create_destroy_mt<NewDeleteSubject>("new_delete", threads);
+		create_destroy_mt<MutexPool>("mutex_pool", threads);
+	}
+
+	for (int threads : thread_counts()) {
+		copy_contended<StoreSubject<DefaultStore>>("sos", threads, [](auto& s) { return std::move(s.make(1)).lock(); });
+		copy_contended<StoreSubject<BiasedStore>>("sos_biased", threads, [](auto& s) { return std::move(s.make(1)).lock(); });
+		copy_contended<SharedPtrSubject>("shared_ptr", threads, [](auto&) { return std::make_shared<const Payload>(1); });
+	}
+
+	lock_round_trip();
+
+	live_objects<DefaultStore>("sos");
+	live_objects<MagazineStore>("sos_magazines");
+	live_objects<BitmapStore>("sos_bitmap");
+
+	if (options.format == "csv") {
+		print_csv();
+	} else if (options.format == "json") {
+		print_json();
+	}
+	return 0;
+}
@@ -0,0 +1,76 @@
+#include <sos/sos.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace mgb;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+constexpr int rounds = 2000;
+
+using Store = sos::SharedObjectStore<int, 1>;
+
+// A waiter blocks on a full store, the main thread releases the only object.
+// Measures the time from the release until the waiter holds the new object
+template<class Create>
+std::vector<double> run(Create create)
+{
+	Store store;
+	std::vector<double> latencies;
+
+	for (int i = 0; i < rounds; ++i) {
+		auto                    blocker = store.create(0);
+		std::atomic<Clock::rep> released{ 0 };
+		std::atomic<Clock::rep> acquired{ 0 };
+		std::atomic_bool        waiting{ false };
+
+		std::thread waiter([&] {
+			waiting = true;
+			auto h  = create(store);
+			acquired = Clock::now().time_since_epoch().count();
+		});
+		while (!waiting) {
+			std::this_thread::yield();
+		}
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+		released = Clock::now().time_since_epoch().count();
+		blocker  = {};
+		waiter.join();
+		latencies.push_back(std::chrono::duration<double, std::micro>(Clock::duration(acquired - released)).count());
+	}
+	std::sort(latencies.begin(), latencies.end());
+	return latencies;
+}
+
+void report(const char* name, const std::vector<double>& l)
+{
+	std::cout << std::setw(12) << name << std::fixed << std::setprecision(2)
+			  << std::setw(10) << l[l.size() / 2]
+			  << std::setw(10) << l[l.size() * 99 / 100]
+			  << std::setw(10) << l.back() << std::endl;
+}
+
+} // namespace
+
+int main()
+{
+	std::cout << "wake up latency after release [us]\n";
+	std::cout << std::setw(12) << "" << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "max" << '\n';
+
+	report("create_wait", run([](Store& s) { return s.create_wait(Clock::now() + std::chrono::seconds(10), 1); }));
+	report("yield-spin", run([](Store& s) {
+		for (;;) {
+			try {
+				return s.create(1);
+			} catch (const std::bad_alloc&) {
+			}
+		}
+	}));
+}
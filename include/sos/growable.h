@@ -0,0 +1,205 @@
+#ifndef MGB_SHARED_OBJECT_STORE_HEADER_GROWABLE_H
+#define MGB_SHARED_OBJECT_STORE_HEADER_GROWABLE_H
+
+#include "sos.h"
+
+#include <atomic>
+#include <limits>
+#include <thread>
+
+namespace mgb { namespace sos {
+
+	namespace detail {
+		template<class Slots, class Engine, class Reclaim>
+		class Segment final : public Store<Slots, Engine, Reclaim> {
+		public:
+			std::atomic<Segment*> next{ nullptr };
+		};
+	}
+
+	/*
+	 * Object store whose capacity grows at runtime by appending segments of SegmentSize slots.
+	 * Segments are never moved or freed before the store dies, so outstanding handles stay valid.
+	 * New segments are appended lock-free to a singly linked list: If multiple threads run out of space at the same time,
+	 * all of them allocate a segment, but only one gets published and the others simply use that one.
+	 * Takes the same policies as SharedObjectStore (which apply per segment), except for sos::stats.
+	 */
+	template<class T, idx_t SegmentSize, class ... Policies>
+	class GrowableObjectStore {
+		using alloc_policy   = detail::select_policy_t<detail::alloc_policy, alloc::free_list, Policies...>;
+		using reclaim_policy = detail::select_policy_t<detail::reclaim_policy, reclaim::immediate, Policies...>;
+		static_assert(std::is_same<detail::select_policy_t<detail::stats_policy, stats::none, Policies...>, stats::none>::value,
+					  "sos::stats is only supported by SharedObjectStore");
+
+		using segment_type = detail::Segment<detail::slots_t<T, SegmentSize, Policies...>, typename alloc_policy::template engine<SegmentSize>, reclaim_policy>;
+
+	public:
+		using slot_type         = typename segment_type::slot_type;
+		using handle_type       = Handle<T, slot_type>;
+		using const_handle_type = ConstHandle<T, slot_type>;
+		using weak_handle_type  = WeakHandle<T, slot_type>;
+
+		static constexpr idx_t no_limit = std::numeric_limits<idx_t>::max();
+
+		// max_capacity gets rounded up to a multiple of SegmentSize
+		explicit GrowableObjectStore(idx_t max_capacity = no_limit)
+			: max_segments((max_capacity - 1) / SegmentSize + 1)
+			, first(new segment_type())
+			, current(first)
+		{
+			assert(max_capacity > 0);
+		}
+		GrowableObjectStore(const GrowableObjectStore&) = delete;
+		GrowableObjectStore& operator=(const GrowableObjectStore&) = delete;
+		~GrowableObjectStore()
+		{
+			auto* seg = first;
+			while (seg) {
+				delete std::exchange(seg, seg->next.load(std::memory_order_relaxed));
+			}
+		}
+
+		template<class ... ARGS>
+		[[nodiscard]] handle_type create(ARGS&& ... args) {
+			int fail_cnt = 0;
+			auto* slot = try_emplace(args...);
+			while (slot == nullptr) {
+				std::this_thread::yield();
+				fail_cnt++;
+				if (fail_cnt > 10) {
+					detail::raise(sos::bad_alloc<GrowableObjectStore>());
+				}
+				slot = try_emplace(args...);
+			}
+			return detail::handle_access::make<handle_type>(*slot);
+		}
+
+		// Like create, but returns an empty handle instead of throwing (or retrying) if the store is full
+		template<class ... ARGS>
+		[[nodiscard]] handle_type try_create(ARGS&& ... args) {
+			auto* slot = try_emplace(args...);
+			return slot ? detail::handle_access::make<handle_type>(*slot) : handle_type{};
+		}
+
+		idx_t live_objects_approx() const noexcept
+		{
+			idx_t cnt = 0;
+			for (auto* seg = first; seg; seg = seg->next.load(std::memory_order_acquire)) {
+				cnt += seg->live_count_approx();
+			}
+			return cnt;
+		}
+		// free slots in the segments allocated so far (not counting future growth)
+		idx_t remaining_capacity_approx() const noexcept
+		{
+			idx_t cnt = 0;
+			for (auto* seg = first; seg; seg = seg->next.load(std::memory_order_acquire)) {
+				cnt += seg->free_count_approx();
+			}
+			return cnt;
+		}
+		idx_t capacity() const noexcept { return segment_cnt.load(std::memory_order_acquire) * SegmentSize; }
+		idx_t max_capacity() const noexcept { return max_segments > no_limit / SegmentSize ? no_limit : max_segments * SegmentSize; }
+
+		// Destroys the objects waiting for deferred reclamation and returns their number (see sos::reclaim::deferred)
+		idx_t collect() noexcept
+		{
+			idx_t cnt = 0;
+			for (auto* seg = first; seg; seg = seg->next.load(std::memory_order_acquire)) {
+				cnt += seg->collect();
+			}
+			return cnt;
+		}
+		// Hands back the spare references all threads cache for this store (see sos::refcount::biased) and returns their number
+		std::size_t flush_refs() noexcept
+		{
+			std::size_t cnt = 0;
+			if constexpr (slot_type::caches_refs) {
+				for (auto* seg = first; seg; seg = seg->next.load(std::memory_order_acquire)) {
+					cnt += seg->flush_refs();
+				}
+			}
+			return cnt;
+		}
+
+	private:
+		const idx_t                max_segments;
+		segment_type* const        first;
+		std::atomic<segment_type*> current;
+		std::atomic<idx_t>         segment_cnt{ 1 }; // published segments
+		std::atomic<idx_t>         reserved_cnt{ 1 }; // published segments plus the ones being allocated
+
+		// Appends a new segment after last (if nobody else did it already and the limit allows it)
+		segment_type* grow(segment_type& last)
+		{
+			if (auto* next = last.next.load(std::memory_order_acquire)) {
+				return next;
+			}
+			if (reserved_cnt.fetch_add(1, std::memory_order_relaxed) >= max_segments) {
+				reserved_cnt.fetch_sub(1, std::memory_order_relaxed);
+				return nullptr;
+			}
+			auto*          seg      = new segment_type();
+			segment_type* expected = nullptr;
+			if (!last.next.compare_exchange_strong(expected, seg, std::memory_order_acq_rel)) {
+				delete seg;
+				reserved_cnt.fetch_sub(1, std::memory_order_relaxed);
+				return expected;
+			}
+			segment_cnt.fetch_add(1, std::memory_order_release);
+			return seg;
+		}
+
+		/*
+		 * Only grows if all segments are full (even after handing back the spare references of idle threads),
+		 * so a steady number of live objects doesn't keep adding segments no matter in which order they are released.
+		 */
+		template<class ... ARGS>
+		slot_type* try_emplace(ARGS&& ... args)
+		{
+			segment_type* last = nullptr;
+			if (auto* slot = try_segments(last, args...)) {
+				return slot;
+			}
+			if (flush_refs() > 0) {
+				if (auto* slot = try_segments(last, args...)) {
+					return slot;
+				}
+			}
+			// another thread may have appended segments meanwhile, grow() hands those out first
+			for (auto* seg = grow(*last); seg; seg = grow(*seg)) {
+				if (auto* slot = seg->try_emplace(args...)) {
+					current.store(seg, std::memory_order_release);
+					return slot;
+				}
+			}
+			return nullptr;
+		}
+
+		// Tries the segments from current to the end (which ends up in last), then wraps around once
+		template<class ... ARGS>
+		slot_type* try_segments(segment_type*& last, ARGS&& ... args)
+		{
+			auto* const start = current.load(std::memory_order_acquire);
+			last              = start;
+			for (auto* seg = start; seg; seg = seg->next.load(std::memory_order_acquire)) {
+				if (auto* slot = seg->try_emplace(args...)) {
+					if (seg != start) {
+						current.store(seg, std::memory_order_release);
+					}
+					return slot;
+				}
+				last = seg;
+			}
+			for (auto* seg = first; seg != start; seg = seg->next.load(std::memory_order_acquire)) {
+				if (auto* slot = seg->try_emplace(args...)) {
+					current.store(seg, std::memory_order_release);
+					return slot;
+				}
+			}
+			return nullptr;
+		}
+	};
+}}
+
+#endif // !MGB_SHARED_OBJECT_STORE_HEADER_GROWABLE_H
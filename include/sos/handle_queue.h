@@ -0,0 +1,167 @@
+#ifndef MGB_SHARED_OBJECT_STORE_HEADER_HANDLE_QUEUE_H
+#define MGB_SHARED_OBJECT_STORE_HEADER_HANDLE_QUEUE_H
+
+#include "sos.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace mgb { namespace sos {
+
+	/*
+	 * Bounded lock-free multi producer / multi consumer queue of handles into a single SharedObjectStore.
+	 * Only the slot index travels through the queue: try_push takes over the reference of the handle and try_pop hands
+	 * it to the consumer, so no refcount is touched on the way. Handle is either the store's handle_type or its
+	 * const_handle_type.
+	 * The algorithm is Dmitry Vyukov's bounded queue: every cell has a sequence number that tells whether it is free
+	 * for the producer or filled for the consumer of a given position. Batches claim a run of consecutive cells with a
+	 * single CAS on the tail (or head).
+	 */
+	template<class Store, class Handle = typename Store::const_handle_type>
+	class HandleQueue {
+		using slot_type = typename Store::slot_type;
+
+		static_assert(std::is_same<Handle, typename Store::handle_type>::value || std::is_same<Handle, typename Store::const_handle_type>::value,
+					  "HandleQueue carries the (const) handles of its store");
+
+		struct Cell {
+			std::atomic<std::size_t> seq;
+			std::uint32_t            idx;
+		};
+
+	public:
+		using handle_type = Handle;
+
+		// capacity gets rounded up to a power of two
+		HandleQueue(Store& store, std::size_t capacity)
+			: store(&store)
+			, mask(round_up(capacity) - 1)
+			, cells(new Cell[mask + 1])
+		{
+			for (std::size_t i = 0; i <= mask; ++i) {
+				cells[i].seq.store(i, std::memory_order_relaxed);
+			}
+		}
+		HandleQueue(const HandleQueue&) = delete;
+		HandleQueue& operator=(const HandleQueue&) = delete;
+		~HandleQueue()
+		{
+			while (!try_pop().empty()) {
+			}
+		}
+
+		// on success, the queue owns the reference of handle (which is empty afterwards). Fails if the queue is full or handle is empty
+		bool try_push(handle_type&& handle) noexcept { return try_push_n(&handle, 1) == 1; }
+
+		/*
+		 * Pushes a prefix of the cnt handles starting at first and returns its length (0 if the queue is full).
+		 * The prefix ends before the first empty handle.
+		 */
+		std::size_t try_push_n(handle_type* first, std::size_t cnt) noexcept
+		{
+			for (std::size_t i = 0; i < cnt; ++i) {
+				if (first[i].empty()) {
+					cnt = i;
+					break;
+				}
+			}
+			if (cnt == 0) {
+				return 0;
+			}
+			auto pos = tail.load(std::memory_order_relaxed);
+			for (;;) {
+				const auto n = ready_run(pos, cnt, 0);
+				if (n == 0) {
+					if (cells[pos & mask].seq.load(std::memory_order_acquire) < pos) {
+						return 0;
+					}
+					pos = tail.load(std::memory_order_relaxed);
+					continue;
+				}
+				if (tail.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+					for (std::size_t i = 0; i < n; ++i) {
+						auto& cell = cells[(pos + i) & mask];
+						cell.idx   = index_of(*detail::handle_access::detach(first[i]));
+						cell.seq.store(pos + i + 1, std::memory_order_release);
+					}
+					return n;
+				}
+			}
+		}
+
+		// an empty handle if the queue is empty
+		handle_type try_pop() noexcept
+		{
+			handle_type handle;
+			try_pop_n(&handle, 1);
+			return handle;
+		}
+
+		// pops up to cnt handles into out (which should be empty handles) and returns their number
+		std::size_t try_pop_n(handle_type* out, std::size_t cnt) noexcept
+		{
+			if (cnt == 0) {
+				return 0;
+			}
+			auto pos = head.load(std::memory_order_relaxed);
+			for (;;) {
+				const auto n = ready_run(pos, cnt, 1);
+				if (n == 0) {
+					if (cells[pos & mask].seq.load(std::memory_order_acquire) < pos + 1) {
+						return 0;
+					}
+					pos = head.load(std::memory_order_relaxed);
+					continue;
+				}
+				if (head.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+					for (std::size_t i = 0; i < n; ++i) {
+						auto& cell = cells[(pos + i) & mask];
+						out[i]     = detail::handle_access::adopt<handle_type>(slot(cell.idx));
+						cell.seq.store(pos + i + mask + 1, std::memory_order_release);
+					}
+					return n;
+				}
+			}
+		}
+
+		std::size_t size_approx() const noexcept
+		{
+			const auto h = head.load(std::memory_order_relaxed);
+			const auto t = tail.load(std::memory_order_relaxed);
+			return t > h ? t - h : 0;
+		}
+		std::size_t capacity() const noexcept { return mask + 1; }
+
+	private:
+		Store* const                  store;
+		const std::size_t             mask;
+		const std::unique_ptr<Cell[]> cells;
+		alignas(detail::cache_line_size) std::atomic<std::size_t> tail{ 0 };
+		alignas(detail::cache_line_size) std::atomic<std::size_t> head{ 0 };
+
+		static std::size_t round_up(std::size_t v) noexcept
+		{
+			std::size_t p = 1;
+			while (p < v) {
+				p *= 2;
+			}
+			return p;
+		}
+
+		// number of consecutive cells (max cnt) from pos on that are ready for a producer (offset 0) or consumer (offset 1)
+		std::size_t ready_run(std::size_t pos, std::size_t cnt, std::size_t offset) const noexcept
+		{
+			std::size_t n = 0;
+			while (n < cnt && n <= mask && cells[(pos + n) & mask].seq.load(std::memory_order_acquire) == pos + n + offset) {
+				++n;
+			}
+			return n;
+		}
+
+		slot_type& slot(std::uint32_t idx) const noexcept { return store->store.data[idx]; }
+		std::uint32_t index_of(const slot_type& s) const noexcept { return static_cast<std::uint32_t>(store->store.data.index_of(s)); }
+	};
+}}
+
+#endif // !MGB_SHARED_OBJECT_STORE_HEADER_HANDLE_QUEUE_H
@@ -0,0 +1,114 @@
+#ifndef MGB_SHARED_OBJECT_STORE_HEADER_HANDLE_VECTOR_H
+#define MGB_SHARED_OBJECT_STORE_HEADER_HANDLE_VECTOR_H
+
+#include "sos.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace mgb { namespace sos {
+
+	/*
+	 * Sequence of const handles into a single SharedObjectStore, which only keeps a 32 bit slot index per element.
+	 * clear() (and the destructor) drop all references in one pass: The indices are sorted, so the refcounts are
+	 * visited in memory order, and all references to the same slot are dropped with a single atomic subtraction.
+	 * Unlike a std::vector of handles, it can't be copied (that would have to touch every refcount).
+	 */
+	template<class Store>
+	class HandleVector {
+		using slot_type = typename Store::slot_type;
+
+	public:
+		using value_type        = typename Store::value_type;
+		using const_handle_type = typename Store::const_handle_type;
+		using handle_type       = typename Store::handle_type;
+
+		explicit HandleVector(Store& store) noexcept
+			: store(&store)
+		{
+		}
+		HandleVector(const HandleVector&) = delete;
+		HandleVector& operator=(const HandleVector&) = delete;
+		HandleVector(HandleVector&& other) noexcept
+			: store(other.store)
+			, idxs(std::move(other.idxs))
+		{
+			other.idxs.clear();
+		}
+		HandleVector& operator=(HandleVector&& other) noexcept
+		{
+			if (this != &other) {
+				clear();
+				store = other.store;
+				idxs  = std::move(other.idxs);
+				other.idxs.clear();
+			}
+			return *this;
+		}
+		~HandleVector() { clear(); }
+
+		// takes over the reference of handle, which has to belong to the same store
+		void push_back(const_handle_type&& handle)
+		{
+			assert(!handle.empty());
+			// grow before detaching, so a failing allocation doesn't lose the reference
+			if (idxs.size() == idxs.capacity()) {
+				idxs.reserve(std::max<std::size_t>(16, idxs.capacity() * 2));
+			}
+			idxs.push_back(index_of(*detail::handle_access::detach(handle)));
+		}
+		void push_back(const const_handle_type& handle) { push_back(const_handle_type(handle)); }
+		void push_back(handle_type&& handle) { push_back(const_handle_type(std::move(handle))); }
+
+		const value_type& operator[](std::size_t i) const noexcept
+		{
+			assert(i < idxs.size());
+			return *slot(idxs[i]).object();
+		}
+		// a new handle to the i-th element
+		const_handle_type handle(std::size_t i) const noexcept
+		{
+			assert(i < idxs.size());
+			auto& s = slot(idxs[i]);
+			s.add_ref();
+			return detail::handle_access::adopt<const_handle_type>(s);
+		}
+		// removes the last element and returns its handle
+		const_handle_type pop_back() noexcept
+		{
+			assert(!idxs.empty());
+			auto& s = slot(idxs.back());
+			idxs.pop_back();
+			return detail::handle_access::adopt<const_handle_type>(s);
+		}
+
+		std::size_t size() const noexcept { return idxs.size(); }
+		bool empty() const noexcept { return idxs.empty(); }
+		void reserve(std::size_t cnt) { idxs.reserve(cnt); }
+
+		// drops all references (sorted by slot, with one atomic operation per distinct slot)
+		void clear() noexcept
+		{
+			std::sort(idxs.begin(), idxs.end());
+			for (std::size_t i = 0; i < idxs.size();) {
+				std::size_t run = 1;
+				while (i + run < idxs.size() && idxs[i + run] == idxs[i]) {
+					++run;
+				}
+				slot(idxs[i]).remove_refs(static_cast<int>(run));
+				i += run;
+			}
+			idxs.clear();
+		}
+
+	private:
+		Store*                     store;
+		std::vector<std::uint32_t> idxs;
+
+		slot_type& slot(std::uint32_t idx) const noexcept { return store->store.data[idx]; }
+		std::uint32_t index_of(const slot_type& s) const noexcept { return static_cast<std::uint32_t>(store->store.data.index_of(s)); }
+	};
+}}
+
+#endif // !MGB_SHARED_OBJECT_STORE_HEADER_HANDLE_VECTOR_H
@@ -0,0 +1,243 @@
+#ifndef MGB_SHARED_OBJECT_STORE_HEADER_NUMA_STORE_H
+#define MGB_SHARED_OBJECT_STORE_HEADER_NUMA_STORE_H
+
+#include "virtual_store.h"
+
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace mgb { namespace sos {
+
+	namespace numa {
+
+		/*
+		 * Mapping of cpus onto NUMA nodes.
+		 * Nodes are numbered densely from 0 to node_cnt() - 1. os_node() translates them into the ids of the OS,
+		 * which are used to bind memory; a fake topology has no os ids and its memory doesn't get bound at all.
+		 */
+		class Topology {
+		public:
+			// cpu_to_node[cpu] is the (dense) node of that cpu
+			Topology(std::vector<int> cpu_to_node, std::vector<int> os_node_ids = {})
+				: cpu_node(std::move(cpu_to_node))
+				, os_nodes(std::move(os_node_ids))
+			{
+				nodes = 1;
+				for (auto n : cpu_node) {
+					assert(n >= 0);
+					nodes = std::max(nodes, n + 1);
+				}
+				assert(os_nodes.empty() || static_cast<int>(os_nodes.size()) == nodes);
+			}
+
+			// node_cnt nodes with the cpus distributed round robin among them
+			static Topology fake(int node_cnt, int cpu_cnt = static_cast<int>(std::thread::hardware_concurrency()))
+			{
+				assert(node_cnt > 0);
+				std::vector<int> cpu_to_node(static_cast<std::size_t>(std::max(cpu_cnt, node_cnt)));
+				for (std::size_t cpu = 0; cpu < cpu_to_node.size(); ++cpu) {
+					cpu_to_node[cpu] = static_cast<int>(cpu) % node_cnt;
+				}
+				return Topology(std::move(cpu_to_node));
+			}
+
+			// Reads the topology from sysfs. Falls back to a single (fake) node if that isn't available
+			static Topology detect()
+			{
+				const auto online = read_list("/sys/devices/system/node/online");
+				if (online.empty()) {
+					return fake(1);
+				}
+				std::vector<int> cpu_to_node;
+				for (std::size_t node = 0; node < online.size(); ++node) {
+					for (int cpu : read_list("/sys/devices/system/node/node" + std::to_string(online[node]) + "/cpulist")) {
+						if (static_cast<std::size_t>(cpu) >= cpu_to_node.size()) {
+							cpu_to_node.resize(static_cast<std::size_t>(cpu) + 1, 0);
+						}
+						cpu_to_node[static_cast<std::size_t>(cpu)] = static_cast<int>(node);
+					}
+				}
+				return Topology(std::move(cpu_to_node), online);
+			}
+
+			int node_cnt() const noexcept { return nodes; }
+			bool is_fake() const noexcept { return os_nodes.empty(); }
+			int os_node(int node) const noexcept { return is_fake() ? -1 : os_nodes[static_cast<std::size_t>(node)]; }
+
+			int node_of_cpu(int cpu) const noexcept
+			{
+				return 0 <= cpu && static_cast<std::size_t>(cpu) < cpu_node.size() ? cpu_node[static_cast<std::size_t>(cpu)] : 0;
+			}
+
+			// node of the cpu the calling thread is currently running on
+			int current_node() const noexcept
+			{
+#if defined(__linux__)
+				return node_of_cpu(sched_getcpu());
+#else
+				return 0;
+#endif
+			}
+
+		private:
+			std::vector<int> cpu_node;
+			std::vector<int> os_nodes;
+			int              nodes = 1;
+
+			// parses the kernel's list format (e.g. "0-3,8,10-11")
+			static std::vector<int> read_list(const std::string& path)
+			{
+				std::vector<int> values;
+				std::ifstream    file(path);
+				std::string      item;
+				while (std::getline(file, item, ',')) {
+					std::istringstream range(item);
+					int first = 0;
+					int last  = 0;
+					if (!(range >> first)) {
+						break;
+					}
+					char dash = 0;
+					last      = range >> dash >> last && dash == '-' ? last : first;
+					for (int v = first; v <= last; ++v) {
+						values.push_back(v);
+					}
+				}
+				return values;
+			}
+		};
+	}
+
+	/*
+	 * Object store with one partition (a VirtualObjectStore of capacity_per_node slots) per NUMA node,
+	 * whose memory is bound to that node.
+	 * create() allocates on the node of the calling cpu and only falls back to the other nodes if that one is full.
+	 * Handles are the same as those of all other stores with the same layout.
+	 * Takes the same policies as VirtualObjectStore.
+	 */
+	template<class T, idx_t SegmentSize = 1024, class ... Policies>
+	class NumaObjectStore {
+		using partition_type = VirtualObjectStore<T, SegmentSize, Policies...>;
+
+	public:
+		using slot_type         = typename partition_type::slot_type;
+		using handle_type       = typename partition_type::handle_type;
+		using const_handle_type = typename partition_type::const_handle_type;
+		using weak_handle_type  = typename partition_type::weak_handle_type;
+
+		// options.node is ignored (every partition is bound to its own node)
+		explicit NumaObjectStore(idx_t capacity_per_node, numa::Topology topo = numa::Topology::detect(), memory_options options = {})
+			: topology(std::move(topo))
+		{
+			for (int node = 0; node < topology.node_cnt(); ++node) {
+				options.node = topology.os_node(node);
+				partitions.push_back(std::make_unique<partition_type>(capacity_per_node, options));
+			}
+		}
+
+		template<class ... ARGS>
+		[[nodiscard]] handle_type create(ARGS&& ... args) {
+			return create_on(topology.current_node(), args...);
+		}
+
+		// like create, but prefers node instead of the node of the calling thread
+		template<class ... ARGS>
+		[[nodiscard]] handle_type create_on(int node, ARGS&& ... args) {
+			assert(0 <= node && node < node_cnt());
+			int fail_cnt = 0;
+			auto* slot = try_emplace(node, args...);
+			while (slot == nullptr) {
+				std::this_thread::yield();
+				fail_cnt++;
+				if (fail_cnt > 10) {
+					detail::raise(sos::bad_alloc<NumaObjectStore>());
+				}
+				slot = try_emplace(node, args...);
+			}
+			return detail::handle_access::make<handle_type>(*slot);
+		}
+
+		// Like create, but returns an empty handle instead of throwing (or retrying) if the store is full
+		template<class ... ARGS>
+		[[nodiscard]] handle_type try_create(ARGS&& ... args) {
+			auto* slot = try_emplace(topology.current_node(), args...);
+			return slot ? detail::handle_access::make<handle_type>(*slot) : handle_type{};
+		}
+
+		idx_t decommit_idle(std::chrono::nanoseconds min_idle = std::chrono::nanoseconds{ 0 })
+		{
+			idx_t cnt = 0;
+			for (auto& p : partitions) {
+				cnt += p->decommit_idle(min_idle);
+			}
+			return cnt;
+		}
+		// Destroys the objects waiting for deferred reclamation and returns their number (see sos::reclaim::deferred)
+		idx_t collect() noexcept
+		{
+			idx_t cnt = 0;
+			for (auto& p : partitions) {
+				cnt += p->collect();
+			}
+			return cnt;
+		}
+		// Hands back the spare references all threads cache for this store (see sos::refcount::biased) and returns their number
+		std::size_t flush_refs() noexcept
+		{
+			std::size_t cnt = 0;
+			for (auto& p : partitions) {
+				cnt += p->flush_refs();
+			}
+			return cnt;
+		}
+		void prefault() noexcept
+		{
+			for (auto& p : partitions) {
+				p->prefault();
+			}
+		}
+
+		idx_t live_objects_approx() const noexcept
+		{
+			idx_t cnt = 0;
+			for (const auto& p : partitions) {
+				cnt += p->live_objects_approx();
+			}
+			return cnt;
+		}
+		idx_t live_objects_approx(int node) const noexcept { return partitions[static_cast<std::size_t>(node)]->live_objects_approx(); }
+		idx_t remaining_capacity_approx() const noexcept { return capacity() - live_objects_approx(); }
+		idx_t capacity() const noexcept { return partitions.front()->capacity() * node_cnt(); }
+
+		int node_cnt() const noexcept { return topology.node_cnt(); }
+		const numa::Topology& get_topology() const noexcept { return topology; }
+		// partition of a node (e.g. to query whether its memory could be bound)
+		const partition_type& partition(int node) const noexcept { return *partitions[static_cast<std::size_t>(node)]; }
+
+	private:
+		numa::Topology                               topology;
+		std::vector<std::unique_ptr<partition_type>> partitions;
+
+		template<class ... ARGS>
+		slot_type* try_emplace(int node, ARGS&& ... args)
+		{
+			for (int n = 0; n < node_cnt(); ++n) {
+				auto& p = *partitions[static_cast<std::size_t>((node + n) % node_cnt())];
+				if (auto* slot = p.try_emplace(args...)) {
+					return slot;
+				}
+			}
+			return nullptr;
+		}
+	};
+}}
+
+#endif // !MGB_SHARED_OBJECT_STORE_HEADER_NUMA_STORE_H
@@ -0,0 +1,66 @@
+#ifndef MGB_SHARED_OBJECT_STORE_HEADER_RECLAIMER_H
+#define MGB_SHARED_OBJECT_STORE_HEADER_RECLAIMER_H
+
+#include "sos.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace mgb { namespace sos {
+
+	/*
+	 * Background thread that calls collect() on a store with deferred reclamation (sos::reclaim::deferred) every interval,
+	 * so the objects get destroyed there instead of on the threads that drop the last reference.
+	 * Has to be destroyed before the store. Collects one last time when stopping.
+	 */
+	template<class Store>
+	class Reclaimer {
+	public:
+		explicit Reclaimer(Store& store, std::chrono::nanoseconds interval = std::chrono::milliseconds{ 1 })
+			: store(store)
+			, interval(interval)
+			, worker([this] { run(); })
+		{
+		}
+		Reclaimer(const Reclaimer&) = delete;
+		Reclaimer& operator=(const Reclaimer&) = delete;
+		~Reclaimer()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				stop = true;
+			}
+			cv.notify_one();
+			worker.join();
+			total.fetch_add(store.collect(), std::memory_order_relaxed);
+		}
+
+		// number of objects destroyed by this reclaimer so far
+		idx_t collected() const noexcept { return total.load(std::memory_order_relaxed); }
+
+	private:
+		Store&                         store;
+		const std::chrono::nanoseconds interval;
+		std::atomic<idx_t>             total{ 0 };
+		std::mutex                     mtx;
+		std::condition_variable        cv;
+		bool                           stop = false;
+		std::thread                    worker;
+
+		void run()
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			while (!stop) {
+				lock.unlock();
+				total.fetch_add(store.collect(), std::memory_order_relaxed);
+				lock.lock();
+				cv.wait_for(lock, interval, [this] { return stop; });
+			}
+		}
+	};
+}}
+
+#endif // !MGB_SHARED_OBJECT_STORE_HEADER_RECLAIMER_H
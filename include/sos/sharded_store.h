@@ -0,0 +1,147 @@
+#ifndef MGB_SHARED_OBJECT_STORE_HEADER_SHARDED_STORE_H
+#define MGB_SHARED_OBJECT_STORE_HEADER_SHARDED_STORE_H
+
+#include "sos.h"
+
+#include <memory>
+#include <thread>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace mgb { namespace sos {
+
+	// Decides which shard of a ShardedObjectStore is the home shard of a thread
+	enum class shard_key {
+		thread, // every thread sticks to one shard (dense thread index modulo shard count)
+		cpu,    // the shard of the cpu the thread currently runs on (falls back to thread on non-linux systems)
+	};
+
+	/*
+	 * Object store split into shard_cnt independent shards of ShardSize slots each.
+	 * Every thread allocates from its home shard and only steals from the other shards if its home shard is full,
+	 * so concurrent creates on different threads mostly don't touch the same free list.
+	 * Takes the same policies as SharedObjectStore (which apply per shard), except for sos::stats.
+	 */
+	template<class T, idx_t ShardSize, class ... Policies>
+	class ShardedObjectStore {
+		using alloc_policy   = detail::select_policy_t<detail::alloc_policy, alloc::free_list, Policies...>;
+		using reclaim_policy = detail::select_policy_t<detail::reclaim_policy, reclaim::immediate, Policies...>;
+		static_assert(std::is_same<detail::select_policy_t<detail::stats_policy, stats::none, Policies...>, stats::none>::value,
+					  "sos::stats is only supported by SharedObjectStore");
+
+		using shard_type = detail::Store<detail::slots_t<T, ShardSize, Policies...>, typename alloc_policy::template engine<ShardSize>, reclaim_policy>;
+
+	public:
+		using slot_type         = typename shard_type::slot_type;
+		using handle_type       = Handle<T, slot_type>;
+		using const_handle_type = ConstHandle<T, slot_type>;
+		using weak_handle_type  = WeakHandle<T, slot_type>;
+
+		explicit ShardedObjectStore(idx_t shard_cnt = std::max(1u, std::thread::hardware_concurrency()), shard_key key = shard_key::thread)
+			: shard_count(shard_cnt)
+			, key(key)
+			, shards(new shard_type[static_cast<std::size_t>(shard_cnt)])
+		{
+			assert(shard_cnt > 0);
+		}
+
+		template<class ... ARGS>
+		[[nodiscard]] handle_type create(ARGS&& ... args) {
+			int fail_cnt = 0;
+			auto* slot = try_emplace(args...);
+			while (slot == nullptr) {
+				std::this_thread::yield();
+				fail_cnt++;
+				if (fail_cnt > 10) {
+					detail::raise(sos::bad_alloc<ShardedObjectStore>());
+				}
+				slot = try_emplace(args...);
+			}
+			return detail::handle_access::make<handle_type>(*slot);
+		}
+
+		// Like create, but returns an empty handle instead of throwing (or retrying) if the store is full
+		template<class ... ARGS>
+		[[nodiscard]] handle_type try_create(ARGS&& ... args) {
+			auto* slot = try_emplace(args...);
+			return slot ? detail::handle_access::make<handle_type>(*slot) : handle_type{};
+		}
+
+		idx_t live_objects_approx() const noexcept { return capacity() - remaining_capacity_approx(); }
+		idx_t remaining_capacity_approx() const noexcept
+		{
+			idx_t cnt = 0;
+			for (idx_t i = 0; i < shard_count; ++i) {
+				cnt += shards[i].free_count_approx();
+			}
+			return cnt;
+		}
+		idx_t capacity() const noexcept { return shard_count * ShardSize; }
+
+		// Destroys the objects waiting for deferred reclamation and returns their number (see sos::reclaim::deferred)
+		idx_t collect() noexcept
+		{
+			idx_t cnt = 0;
+			for (idx_t i = 0; i < shard_count; ++i) {
+				cnt += shards[i].collect();
+			}
+			return cnt;
+		}
+
+		// Hands back the spare references all threads cache for this store (see sos::refcount::biased) and returns their number
+		std::size_t flush_refs() noexcept
+		{
+			if constexpr (slot_type::caches_refs) {
+				return detail::RefCache::purge(shards.get(), shards.get() + shard_count);
+			} else {
+				return 0;
+			}
+		}
+
+		idx_t shard_cnt() const noexcept { return shard_count; }
+		// shard the calling thread allocates from first
+		idx_t home_shard() const noexcept
+		{
+#if defined(__linux__)
+			if (key == shard_key::cpu) {
+				const int cpu = sched_getcpu();
+				if (cpu >= 0) {
+					return cpu % shard_count;
+				}
+			}
+#endif
+			return static_cast<idx_t>(detail::this_thread_index() % static_cast<std::size_t>(shard_count));
+		}
+
+	private:
+		const idx_t                   shard_count;
+		const shard_key               key;
+		std::unique_ptr<shard_type[]> shards;
+
+		template<class ... ARGS>
+		slot_type* try_emplace(ARGS&& ... args)
+		{
+			if (auto* slot = try_shards(args...)) {
+				return slot;
+			}
+			// the store may only be full because idle threads still cache spare references
+			return flush_refs() > 0 ? try_shards(args...) : nullptr;
+		}
+
+		template<class ... ARGS>
+		slot_type* try_shards(ARGS&& ... args)
+		{
+			const idx_t home = home_shard();
+			for (idx_t n = 0; n < shard_count; ++n) {
+				if (auto* slot = shards[(home + n) % shard_count].try_emplace(args...)) {
+					return slot;
+				}
+			}
+			return nullptr;
+		}
+	};
+}}
+
+#endif // !MGB_SHARED_OBJECT_STORE_HEADER_SHARDED_STORE_H
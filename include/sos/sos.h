@@ -7,114 +7,1937 @@
 #include <cassert>
 #include <algorithm>
 #include <stdexcept>
+#include <exception>
 #include <thread>
 #include <new>
+#include <utility>
+#include <limits>
+#include <cstdint>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+#else
+#include <condition_variable>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/*
+ * Builds without exception support (e.g. -fno-exceptions) are detected automatically, but SOS_NO_EXCEPTIONS can also be
+ * defined explicitly. In that mode, errors that would otherwise throw call the failure handler and abort.
+ */
+#if !defined(SOS_NO_EXCEPTIONS) && !(defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND))
+#define SOS_NO_EXCEPTIONS
+#endif
+
+/*
+ * Defining SOS_ENABLE_TRACE (consistently for the whole program) compiles in the hooks for SharedObjectStore::start_trace
+ * (see sos/trace.h). Without it, tracing costs nothing.
+ */
 
 namespace mgb { namespace sos {
 	constexpr const char* my_name() noexcept { return "Shared Object Store Library"; }
 	using idx_t = std::intptr_t;
 
 	template<class T>
-	struct bad_alloc : std::bad_alloc {
-		const char* what() const noexcept override { return "No free slot in shared object store found"; }
+	struct bad_alloc : std::bad_alloc {
+		const char* what() const noexcept override { return "No free slot in shared object store found"; }
+	};
+
+	// Gets called with the error message before aborting, if the library is built without exceptions
+	using failure_handler = void (*)(const char* what) noexcept;
+
+	namespace detail {
+		inline std::atomic<failure_handler>& failure_handler_instance() noexcept
+		{
+			static std::atomic<failure_handler> handler{ nullptr };
+			return handler;
+		}
+
+		// throws e or - without exception support - calls the failure handler and aborts
+		template<class E>
+		[[noreturn]] void raise(E&& e)
+		{
+#if defined(SOS_NO_EXCEPTIONS)
+			if (auto handler = failure_handler_instance().load()) {
+				handler(e.what());
+			}
+			std::abort();
+#else
+			throw std::forward<E>(e);
+#endif
+		}
+	}
+
+	// Returns the previous handler
+	inline failure_handler set_failure_handler(failure_handler handler) noexcept
+	{
+		return detail::failure_handler_instance().exchange(handler);
+	}
+
+	// Events recorded by tracing (see sos/trace.h)
+	enum class trace_event : std::uint8_t {
+		attach,  // tracing of a store started (the slot field holds its capacity)
+		create,  // an object was constructed in the slot
+		acquire, // a reference was added (handle copied, weak handle or id locked)
+		release, // a reference was dropped
+		lock,    // a modifiable handle became a const handle
+		unlock,  // a const handle became a modifiable handle again
+	};
+
+	namespace detail {
+
+		constexpr std::size_t cache_line_size = 64;
+
+		// Receives the events of a traced store (implemented by sos::TraceRecorder)
+		class TraceSink {
+		public:
+			virtual void record(trace_event event, std::uint32_t slot) noexcept = 0;
+
+		protected:
+			~TraceSink() = default;
+		};
+
+		// Interface of everything that hands out slots.
+		// It gets notified, once the last reference to an object was dropped and the slot is free again
+		template<class SlotT>
+		class SlotPool {
+		public:
+			virtual void release(SlotT& slot) noexcept = 0;
+			// Only used if defers_destruction(): Takes over a slot whose last reference was dropped, but whose object still lives
+			virtual void retire(SlotT& slot) noexcept = 0;
+
+			bool defers_destruction() const noexcept { return deferred; }
+
+#if defined(SOS_ENABLE_TRACE)
+			void trace(const SlotT& slot, trace_event event) noexcept
+			{
+				if (auto* sink = tracer.load(std::memory_order_acquire)) {
+					sink->record(event, trace_index(slot));
+				}
+			}
+			void set_tracer(TraceSink* sink) noexcept { tracer.store(sink, std::memory_order_release); }
+#endif
+
+		protected:
+			explicit SlotPool(bool defer_destruction = false) noexcept
+				: deferred(defer_destruction)
+			{
+			}
+			~SlotPool() = default;
+
+#if defined(SOS_ENABLE_TRACE)
+			virtual std::uint32_t trace_index(const SlotT& slot) const noexcept = 0;
+#endif
+
+		private:
+			const bool deferred;
+#if defined(SOS_ENABLE_TRACE)
+			std::atomic<TraceSink*> tracer{ nullptr };
+#endif
+		};
+
+		// Reports event to the tracer of the slot's store (a no-op unless SOS_ENABLE_TRACE is defined)
+		template<class SlotT>
+		void trace([[maybe_unused]] SlotT& slot, [[maybe_unused]] trace_event event, [[maybe_unused]] int cnt = 1) noexcept
+		{
+#if defined(SOS_ENABLE_TRACE)
+			for (int i = 0; i < cnt; ++i) {
+				slot.trace(event);
+			}
+#endif
+		}
+
+		/*
+		 * Reference count of a slot, packed into one word together with a generation, which changes whenever the object
+		 * of the slot is destroyed (or becomes mutable again), so weak handles can tell if their object is still around.
+		 * 0 references mean free, 1 means claimed (the object is being created or waits for destruction)
+		 * and every handle adds one more.
+		 * The top bit of the count marks objects that are (or may be) modified through a Handle. It is set when the
+		 * slot is claimed or made exclusive again and cleared when the object gets published as const (Handle::lock()),
+		 * so visitors (SharedObjectStore::for_each_live) only ever pin const objects.
+		 */
+		class RefCount {
+			std::atomic<std::uint64_t> state{ 0 };
+
+			static constexpr std::uint32_t mutable_flag = std::uint32_t{ 1 } << 31;
+
+			static constexpr std::uint64_t pack(std::uint32_t gen, std::uint32_t cnt) noexcept { return (std::uint64_t{ gen } << 32) | cnt; }
+			static constexpr std::uint32_t count(std::uint64_t s) noexcept { return static_cast<std::uint32_t>(s) & ~mutable_flag; }
+			static constexpr std::uint32_t gen(std::uint64_t s) noexcept { return static_cast<std::uint32_t>(s >> 32); }
+			static constexpr bool is_mutable(std::uint64_t s) noexcept { return (s & mutable_flag) != 0; }
+
+		public:
+			bool try_claim() noexcept
+			{
+				auto s = state.load(std::memory_order_relaxed);
+				return count(s) == 0 && state.compare_exchange_strong(s, pack(gen(s), 1 | mutable_flag));
+			}
+			// the object is const from now on (until try_make_exclusive)
+			void publish() noexcept { state.fetch_and(~std::uint64_t{ mutable_flag }, std::memory_order_release); }
+			void add(std::uint32_t cnt = 1) noexcept { state.fetch_add(cnt, std::memory_order_relaxed); }
+			// returns true if those were the last references (so only the claim is left)
+			bool remove(std::uint32_t cnt = 1) noexcept
+			{
+				const auto old = state.fetch_sub(cnt);
+				assert(count(old) > cnt);
+				return count(old) == cnt + 1;
+			}
+			// frees a claimed slot, which starts a new generation
+			void reset() noexcept
+			{
+				const auto s = state.load(std::memory_order_relaxed);
+				assert(count(s) == 1);
+				state.store(pack(gen(s) + 1, 0));
+			}
+
+			// adds a reference if the object of generation g is still alive and shared (only the bits in mask are compared)
+			bool try_add(std::uint32_t g, std::uint32_t mask = ~std::uint32_t{ 0 }) noexcept
+			{
+				auto s = state.load();
+				while ((gen(s) & mask) == g && count(s) >= 2 && !is_mutable(s)) {
+					if (state.compare_exchange_weak(s, s + 1)) {
+						return true;
+					}
+				}
+				return false;
+			}
+			// adds a reference if the slot holds a published (const) object, whatever its generation
+			bool try_pin() noexcept
+			{
+				auto s = state.load(std::memory_order_relaxed);
+				while (count(s) >= 2 && !is_mutable(s)) {
+					if (state.compare_exchange_weak(s, s + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+						return true;
+					}
+				}
+				return false;
+			}
+			// if the caller holds the only reference, starts a new generation, so weak handles can't add references any more
+			bool try_make_exclusive() noexcept
+			{
+				auto s = state.load();
+				return count(s) == 2 && !is_mutable(s) && state.compare_exchange_strong(s, pack(gen(s) + 1, 2 | mutable_flag));
+			}
+
+			std::uint32_t generation() const noexcept { return gen(state.load()); }
+			// true if the object of generation g is still alive and shared
+			bool is_alive(std::uint32_t g, std::uint32_t mask = ~std::uint32_t{ 0 }) const noexcept
+			{
+				const auto s = state.load();
+				return (gen(s) & mask) == g && count(s) >= 2 && !is_mutable(s);
+			}
+			bool is_free() const noexcept { return count(state.load(std::memory_order_relaxed)) == 0; }
+			// true if a single handle holds the object (plus spare references the caller knows about)
+			bool is_unique(std::uint32_t spare = 0) const noexcept { return count(state.load()) == 2 + spare; }
+			bool is_mutable() const noexcept { return is_mutable(state.load(std::memory_order_relaxed)); }
+		};
+
+		/*
+		 * Per thread cache of spare references for slots with biased reference counting (sos::refcount::biased).
+		 * Every spare reference is a real one (i.e. counted in the slot's refcount), so copying a handle can take a
+		 * spare and dropping a handle can put its reference back without touching the shared refcount. The cost is, that
+		 * an object only gets destroyed once the spares of all threads have been handed back: That happens if a slot
+		 * collects too many of them, if it gets evicted from the (direct mapped) cache, every flush_interval operations,
+		 * on flush(), when the thread exits and on purge() (which a store calls without help of the caching threads).
+		 * The cache is guarded by a try-lock, which is only ever contended by purge. If the lock can't be taken
+		 * (e.g. reentrant use from a destructor), the references are counted directly.
+		 */
+		class RefCache {
+		public:
+			using drop_fn = void (*)(void* slot, std::uint32_t cnt) noexcept;
+
+			// nullptr once the thread is exiting (or if the cache couldn't be allocated)
+			static RefCache* local() noexcept
+			{
+				auto& tls = local_state();
+				if (tls.cache || tls.dead) {
+					return tls.cache;
+				}
+				tls.cache = new (std::nothrow) RefCache();
+				thread_local Guard guard;
+				return tls.cache;
+			}
+
+			// takes one spare reference of slot, false if there is none
+			bool take(void* slot) noexcept
+			{
+				if (!try_lock()) {
+					return false;
+				}
+				auto& e     = entries[bucket(slot)];
+				const bool hit = e.slot == slot && e.spare > 0;
+				if (hit) {
+					--e.spare;
+				}
+				unlock();
+				return hit;
+			}
+
+			// adds cnt spare references of slot, anything above max_spare is handed back right away
+			void give(void* slot, std::uint32_t cnt, drop_fn drop, std::uint32_t max_spare) noexcept
+			{
+				if (!try_lock()) {
+					drop(slot, cnt);
+					return;
+				}
+				Entry evicted;
+				auto& e = entries[bucket(slot)];
+				if (e.slot != slot) {
+					evicted = std::exchange(e, Entry{ slot, 0, drop });
+				}
+				e.spare += cnt;
+				std::uint32_t excess = 0;
+				if (e.spare > max_spare) {
+					excess  = e.spare - max_spare / 2;
+					e.spare = max_spare / 2;
+				}
+				const bool flush_now = ++ops % flush_interval == 0;
+				unlock();
+				if (excess > 0) {
+					drop(slot, excess);
+				}
+				evicted.hand_back();
+				if (flush_now) {
+					flush();
+				}
+			}
+
+			// hands all spare references of this thread back
+			void flush() noexcept { drain([](const Entry&) { return true; }); }
+
+			// number of spare references the calling thread caches for slot (0 if its cache is busy)
+			static std::uint32_t local_spares(const void* slot) noexcept
+			{
+				auto* const cache = local_state().cache;
+				if (cache == nullptr || !cache->try_lock()) {
+					return 0;
+				}
+				const auto& e   = cache->entries[bucket(slot)];
+				const auto  cnt = e.slot == slot ? e.spare : 0;
+				cache->unlock();
+				return cnt;
+			}
+
+			/*
+			 * Hands back the spares of all threads for slots in [first, last) and returns their number. Used by a store
+			 * that is full or dying, so spares of idle threads don't keep objects alive.
+			 * The references are handed back outside of the registry lock, as that may destroy objects.
+			 */
+			static std::size_t purge(const void* first, const void* last) noexcept
+			{
+				const auto  in_range = [=](const Entry& e) { return first <= e.slot && e.slot < last; };
+				std::size_t total    = 0;
+				for (;;) {
+					Entry       batch[entry_cnt];
+					std::size_t n = 0;
+					{
+						std::lock_guard<std::mutex> lock(registry_mutex());
+						for (auto* c = registry_head(); c && n == 0; c = c->next_cache) {
+							while (!c->try_lock()) {
+								std::this_thread::yield();
+							}
+							n = c->extract(in_range, batch);
+							c->unlock();
+						}
+					}
+					if (n == 0) {
+						return total;
+					}
+					for (std::size_t i = 0; i < n; ++i) {
+						total += batch[i].spare;
+						batch[i].hand_back();
+					}
+				}
+			}
+
+		private:
+			static constexpr std::size_t   entry_cnt      = 64;
+			static constexpr std::uint32_t flush_interval = 1 << 12;
+
+			struct Entry {
+				void*         slot  = nullptr;
+				std::uint32_t spare = 0;
+				drop_fn       drop  = nullptr;
+
+				void hand_back() const noexcept
+				{
+					if (spare > 0) {
+						drop(slot, spare);
+					}
+				}
+			};
+			struct LocalState {
+				RefCache* cache = nullptr;
+				bool      dead  = false;
+			};
+			// destroys the cache at thread exit. LocalState itself is trivially destructible, so it stays usable
+			struct Guard {
+				~Guard()
+				{
+					auto& tls = local_state();
+					tls.dead  = true;
+					delete std::exchange(tls.cache, nullptr);
+				}
+			};
+
+			std::atomic_flag busy = ATOMIC_FLAG_INIT;
+			std::uint32_t    ops  = 0;
+			std::array<Entry, entry_cnt> entries{};
+			RefCache*        next_cache = nullptr;
+
+			RefCache() noexcept
+			{
+				std::lock_guard<std::mutex> lock(registry_mutex());
+				next_cache      = registry_head();
+				registry_head() = this;
+			}
+			~RefCache()
+			{
+				{
+					std::lock_guard<std::mutex> lock(registry_mutex());
+					auto** p = &registry_head();
+					while (*p != this) {
+						p = &(*p)->next_cache;
+					}
+					*p = next_cache;
+				}
+				flush();
+			}
+
+			static LocalState& local_state() noexcept
+			{
+				thread_local LocalState state;
+				return state;
+			}
+			static std::mutex& registry_mutex() noexcept
+			{
+				static std::mutex mtx;
+				return mtx;
+			}
+			static RefCache*& registry_head() noexcept
+			{
+				static RefCache* head = nullptr;
+				return head;
+			}
+
+			static std::size_t bucket(const void* slot) noexcept
+			{
+				const auto v = reinterpret_cast<std::uintptr_t>(slot);
+				return ((v >> 4) ^ (v >> 10)) % entry_cnt;
+			}
+
+			bool try_lock() noexcept { return !busy.test_and_set(std::memory_order_acquire); }
+			void unlock() noexcept { busy.clear(std::memory_order_release); }
+
+			// moves the entries matching pred into out (has to be called with the lock held)
+			template<class Pred>
+			std::size_t extract(Pred pred, Entry* out) noexcept
+			{
+				std::size_t n = 0;
+				for (auto& e : entries) {
+					if (e.slot && pred(e)) {
+						out[n++] = std::exchange(e, Entry{});
+					}
+				}
+				return n;
+			}
+			// hands back the matching entries outside of the lock, as that may destroy objects
+			template<class Pred>
+			void drain(Pred pred) noexcept
+			{
+				while (!try_lock()) {
+					std::this_thread::yield();
+				}
+				Entry batch[entry_cnt];
+				const auto n = extract(pred, batch);
+				unlock();
+				for (std::size_t i = 0; i < n; ++i) {
+					batch[i].hand_back();
+				}
+			}
+		};
+
+		/*
+		 * Refcount and object side by side.
+		 * With a Batch > 0, references are counted through the RefCache of the calling thread: a miss adds Batch references
+		 * at once and keeps the ones that aren't needed yet as spares.
+		 * With Recycler (see sos::recycle::reuse), the object of a released slot is only reset and stays constructed. A slot
+		 * holds such an object once it has been used (i.e. pool is set).
+		 */
+		template<class T, std::uint32_t Batch = 0, class Recycler = void>
+		class Slot {
+			std::aligned_storage_t<sizeof(T), alignof(T)> data{};
+			RefCount        refs;
+			SlotPool<Slot>* pool = nullptr;
+
+		public:
+			using value_type = T;
+			using pool_type  = SlotPool<Slot>;
+
+			static constexpr bool caches_refs = Batch > 0;
+			static constexpr bool recycles    = !std::is_void<Recycler>::value;
+
+			template<class ... ARGS>
+			bool try_create(pool_type& owner, ARGS&& ... args) {
+				if (refs.try_claim()) {
+#if defined(SOS_NO_EXCEPTIONS)
+					init(std::forward<ARGS>(args)...);
+#else
+					try {
+						init(std::forward<ARGS>(args)...);
+					} catch (...) {
+						// hand the slot back, so a throwing constructor doesn't leak capacity
+						refs.reset();
+						owner.release(*this);
+						throw;
+					}
+#endif
+					pool = &owner;
+					detail::trace(*this, trace_event::create);
+					return true;
+				}
+				return false;
+			}
+			void add_ref() noexcept {
+				detail::trace(*this, trace_event::acquire);
+				if constexpr (caches_refs) {
+					auto* cache = RefCache::local();
+					if (cache == nullptr) {
+						refs.add();
+					} else if (!cache->take(this)) {
+						// a modifiable handle is the only one (e.g. the one of create), so there is nothing to batch
+						if (refs.is_mutable()) {
+							refs.add();
+						} else {
+							refs.add(Batch);
+							cache->give(this, Batch - 1, &drop_refs, 2 * Batch);
+						}
+					}
+				} else {
+					refs.add();
+				}
+			}
+			void remove_ref() noexcept {
+				detail::trace(*this, trace_event::release);
+				if constexpr (caches_refs) {
+					// the reference of a modifiable handle is the last one, caching it would only delay the destruction
+					if (auto* cache = RefCache::local(); cache != nullptr && !refs.is_mutable()) {
+						cache->give(this, 1, &drop_refs, 2 * Batch);
+						return;
+					}
+				}
+				if (refs.remove()) {
+					last_ref_dropped();
+				}
+			}
+			// drops cnt references with a single atomic operation (bypassing the RefCache)
+			void remove_refs(int cnt) noexcept {
+				assert(cnt > 0);
+				detail::trace(*this, trace_event::release, cnt);
+				drop(static_cast<std::uint32_t>(cnt));
+			}
+			// destroys (or resets for recycling) the object and hands the slot back to its pool
+			void destroy() noexcept {
+				if constexpr (recycles) {
+					Recycler::reset(*object());
+				} else {
+					object()->~T();
+				}
+				auto* const owner = pool;
+				refs.reset();
+				owner->release(*this);
+			}
+			// destroys the object a free slot keeps for recycling (when the store dies)
+			void discard() noexcept {
+				if constexpr (recycles) {
+					if (pool != nullptr && refs.is_free()) {
+						object()->~T();
+					}
+				}
+			}
+			T* object() noexcept { return std::launder(reinterpret_cast<T*>(&data)); }
+
+			RefCount& ref_count() noexcept { return refs; }
+			bool is_free() const noexcept { return refs.is_free(); }
+			bool is_uniquely_owned() const noexcept {
+				if constexpr (caches_refs) {
+					return refs.is_unique(RefCache::local_spares(this));
+				} else {
+					return refs.is_unique();
+				}
+			}
+
+#if defined(SOS_ENABLE_TRACE)
+			void trace(trace_event event) noexcept { pool->trace(*this, event); }
+#endif
+
+		private:
+			template<class ... ARGS>
+			void init(ARGS&& ... args) {
+				if constexpr (recycles) {
+					if (pool != nullptr) {
+						Recycler::reinit(*object(), std::forward<ARGS>(args)...);
+						return;
+					}
+				}
+				new(&data) T(std::forward<ARGS>(args)...);
+			}
+			void drop(std::uint32_t cnt) noexcept {
+				if (refs.remove(cnt)) {
+					last_ref_dropped();
+				}
+			}
+			// the slot stays claimed (refcount 1) while it waits for deferred destruction
+			void last_ref_dropped() noexcept {
+				if (pool->defers_destruction()) {
+					pool->retire(*this);
+				} else {
+					destroy();
+				}
+			}
+			// hands spare references of the RefCache back (they were traced when the handles using them came and went)
+			static void drop_refs(void* slot, std::uint32_t cnt) noexcept { static_cast<Slot*>(slot)->drop(cnt); }
+		};
+
+		template<class T>
+		class SplitSlot;
+
+		/*
+		 * Pool for the split layout, which additionally knows where the (densely packed) objects live.
+		 * The index of a refcount cell is derived from its address, so the cells don't have to store it.
+		 */
+		template<class T>
+		class SplitPool : public SlotPool<SplitSlot<T>> {
+		public:
+			using storage_type = std::aligned_storage_t<sizeof(T), alignof(T)>;
+
+			void* storage(const SplitSlot<T>& slot) noexcept { return &objects[index_of(slot)]; }
+			T* object(const SplitSlot<T>& slot) noexcept { return std::launder(reinterpret_cast<T*>(&objects[index_of(slot)])); }
+			// stride between two refcount cells has to be a power of two
+			void bind(storage_type* first_object, const void* first_ref, std::size_t stride_log2) noexcept
+			{
+				objects   = first_object;
+				refs      = static_cast<const char*>(first_ref);
+				ref_shift = stride_log2;
+			}
+
+		protected:
+			explicit SplitPool(bool defer_destruction = false) noexcept
+				: SlotPool<SplitSlot<T>>(defer_destruction)
+			{
+			}
+			~SplitPool() = default;
+
+		private:
+			storage_type* objects   = nullptr;
+			const char*   refs      = nullptr;
+			std::size_t   ref_shift = 0;
+
+			std::size_t index_of(const SplitSlot<T>& slot) const noexcept
+			{
+				return static_cast<std::size_t>(reinterpret_cast<const char*>(&slot) - refs) >> ref_shift;
+			}
+		};
+
+		// Refcount cell of the split layout. The object itself lives in a separate array of the pool
+		template<class T>
+		class SplitSlot {
+			RefCount      refs;
+			SplitPool<T>* pool = nullptr;
+
+		public:
+			using value_type = T;
+			using pool_type  = SplitPool<T>;
+
+			static constexpr bool caches_refs = false;
+			static constexpr bool recycles    = false;
+
+			template<class ... ARGS>
+			bool try_create(pool_type& owner, ARGS&& ... args) {
+				if (refs.try_claim()) {
+					pool = &owner;
+#if defined(SOS_NO_EXCEPTIONS)
+					new(owner.storage(*this)) T(std::forward<ARGS>(args)...);
+#else
+					try {
+						new(owner.storage(*this)) T(std::forward<ARGS>(args)...);
+					} catch (...) {
+						refs.reset();
+						owner.release(*this);
+						throw;
+					}
+#endif
+					detail::trace(*this, trace_event::create);
+					return true;
+				}
+				return false;
+			}
+			void add_ref() noexcept {
+				detail::trace(*this, trace_event::acquire);
+				refs.add();
+			}
+			void remove_ref() noexcept {
+				detail::trace(*this, trace_event::release);
+				if (refs.remove()) {
+					last_ref_dropped();
+				}
+			}
+			// drops cnt references with a single atomic operation
+			void remove_refs(int cnt) noexcept {
+				assert(cnt > 0);
+				detail::trace(*this, trace_event::release, cnt);
+				if (refs.remove(static_cast<std::uint32_t>(cnt))) {
+					last_ref_dropped();
+				}
+			}
+			// destroys the object and hands the slot back to its pool
+			void destroy() noexcept {
+				object()->~T();
+				auto* const owner = pool;
+				refs.reset();
+				owner->release(*this);
+			}
+			T* object() noexcept { return pool->object(*this); }
+
+			RefCount& ref_count() noexcept { return refs; }
+			bool is_free() const noexcept { return refs.is_free(); }
+			bool is_uniquely_owned() const noexcept { return refs.is_unique(); }
+
+#if defined(SOS_ENABLE_TRACE)
+			void trace(trace_event event) noexcept { pool->trace(*this, event); }
+#endif
+
+		private:
+			// the slot stays claimed (refcount 1) while it waits for deferred destruction
+			void last_ref_dropped() noexcept {
+				if (pool->defers_destruction()) {
+					pool->retire(*this);
+				} else {
+					destroy();
+				}
+			}
+		};
+
+		// Array of slots with refcount and object side by side
+		template<class T, idx_t Size, class SlotT = Slot<T>>
+		class InterleavedSlots {
+			std::array<SlotT, Size> data;
+
+		public:
+			using slot_type = SlotT;
+
+			static constexpr idx_t size = Size;
+
+			void bind(typename slot_type::pool_type&) noexcept {}
+
+			slot_type& operator[](idx_t idx) noexcept { return data[idx]; }
+			idx_t index_of(const slot_type& slot) const noexcept { return &slot - data.data(); }
+
+			auto begin() const noexcept { return data.begin(); }
+			auto end() const noexcept { return data.end(); }
+		};
+
+		// Refcounts in their own array (RefsPerLine of them sharing a cache line), objects densely packed in another one
+		template<class T, idx_t Size, std::size_t RefsPerLine>
+		class SplitSlots {
+			static_assert(RefsPerLine > 0 && cache_line_size % RefsPerLine == 0, "RefsPerLine has to divide the cache line size");
+
+			static constexpr std::size_t stride = cache_line_size / RefsPerLine;
+
+			struct alignas(stride) PaddedSlot : SplitSlot<T> {};
+			static_assert(sizeof(SplitSlot<T>) <= stride, "Too many refcounts per cache line");
+			static_assert(sizeof(PaddedSlot) == stride && (stride & (stride - 1)) == 0, "Refcount index is computed with a shift");
+
+			static constexpr std::size_t log2(std::size_t v) noexcept { return v <= 1 ? 0 : 1 + log2(v / 2); }
+
+			std::array<PaddedSlot, Size> refs;
+			std::array<typename SplitPool<T>::storage_type, Size> objects;
+
+		public:
+			using slot_type = SplitSlot<T>;
+
+			static constexpr idx_t size = Size;
+
+			void bind(typename slot_type::pool_type& pool) noexcept { pool.bind(objects.data(), refs.data(), log2(stride)); }
+
+			slot_type& operator[](idx_t idx) noexcept { return refs[idx]; }
+			idx_t index_of(const slot_type& slot) const noexcept { return static_cast<const PaddedSlot*>(&slot) - refs.data(); }
+
+			auto begin() const noexcept { return refs.begin(); }
+			auto end() const noexcept { return refs.end(); }
+		};
+
+		// Receives what a free slot search costs (see sos::stats). This one ignores it
+		struct NoProbe {
+			void cas_failed() noexcept {}
+			void scanned(idx_t) noexcept {}
+		};
+
+		/*
+		 * Lock-free LIFO stack of free slot indices (Treiber stack).
+		 * The head is tagged with a counter that is incremented on every successful pop/push, which makes it ABA-safe.
+		 * Being a stack, the most recently released (and thus probably still cached) slot is handed out first.
+		 */
+		template<idx_t Size>
+		class FreeList {
+			static_assert(Size > 0 && Size < std::numeric_limits<std::uint32_t>::max(), "FreeList indices have to fit into 32 bit");
+
+			static constexpr std::uint32_t nil = std::numeric_limits<std::uint32_t>::max();
+
+			static constexpr std::uint64_t pack(std::uint32_t tag, std::uint32_t idx) noexcept
+			{
+				return (std::uint64_t{ tag } << 32) | idx;
+			}
+			static constexpr std::uint32_t index(std::uint64_t head) noexcept { return static_cast<std::uint32_t>(head); }
+			static constexpr std::uint32_t tag(std::uint64_t head) noexcept { return static_cast<std::uint32_t>(head >> 32); }
+
+			alignas(cache_line_size) std::atomic<std::uint64_t> head{ pack(0, 0) };
+			alignas(cache_line_size) std::array<std::atomic<std::uint32_t>, Size> next;
+
+		public:
+			FreeList() noexcept
+			{
+				for (idx_t i = 0; i < Size - 1; ++i) {
+					next[i].store(static_cast<std::uint32_t>(i + 1), std::memory_order_relaxed);
+				}
+				next[Size - 1].store(nil, std::memory_order_relaxed);
+			}
+
+			// returns -1 if there is no free slot left
+			idx_t pop() noexcept
+			{
+				NoProbe probe;
+				return pop(probe);
+			}
+			template<class Probe>
+			idx_t pop(Probe& probe) noexcept
+			{
+				auto old = head.load(std::memory_order_acquire);
+				while (index(old) != nil) {
+					const auto succ = next[index(old)].load(std::memory_order_relaxed);
+					if (head.compare_exchange_weak(old, pack(tag(old) + 1, succ), std::memory_order_acquire, std::memory_order_acquire)) {
+						return index(old);
+					}
+					probe.cas_failed();
+				}
+				return -1;
+			}
+
+			/*
+			 * Pops up to cnt indices with a single successful CAS on the head and returns how many it got.
+			 * The chain is walked before the CAS; as every pop/push bumps the tag, a successful CAS proves it didn't change.
+			 */
+			std::size_t pop_n(std::uint32_t* out, std::size_t cnt) noexcept
+			{
+				auto old = head.load(std::memory_order_acquire);
+				while (cnt > 0 && index(old) != nil) {
+					std::size_t n   = 0;
+					auto        idx = index(old);
+					do {
+						out[n++] = idx;
+						idx      = next[idx].load(std::memory_order_relaxed);
+					} while (n < cnt && idx != nil);
+					if (head.compare_exchange_weak(old, pack(tag(old) + 1, idx), std::memory_order_acquire, std::memory_order_acquire)) {
+						return n;
+					}
+				}
+				return 0;
+			}
+
+			void push(idx_t idx) noexcept
+			{
+				assert(0 <= idx && idx < Size);
+				auto old = head.load(std::memory_order_relaxed);
+				do {
+					next[idx].store(index(old), std::memory_order_relaxed);
+				} while (!head.compare_exchange_weak(old, pack(tag(old) + 1, static_cast<std::uint32_t>(idx)), std::memory_order_seq_cst, std::memory_order_relaxed));
+			}
+
+			// pushes all cnt indices with a single successful CAS on the head
+			void push_n(const std::uint32_t* idxs, std::size_t cnt) noexcept
+			{
+				if (cnt == 0) {
+					return;
+				}
+				for (std::size_t i = 0; i + 1 < cnt; ++i) {
+					next[idxs[i]].store(idxs[i + 1], std::memory_order_relaxed);
+				}
+				auto old = head.load(std::memory_order_relaxed);
+				do {
+					next[idxs[cnt - 1]].store(index(old), std::memory_order_relaxed);
+				} while (!head.compare_exchange_weak(old, pack(tag(old) + 1, idxs[0]), std::memory_order_seq_cst, std::memory_order_relaxed));
+			}
+		};
+
+		// Small dense number for the calling thread (assigned on first use)
+		inline std::size_t this_thread_index() noexcept
+		{
+			static std::atomic<std::size_t> next_index{ 0 };
+			thread_local const std::size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+			return index;
+		}
+
+		/*
+		 * Free list with a front end of per-thread caches ("magazines") of free slot indices.
+		 * Each thread is mapped onto one magazine, which is refilled from / drained into the global free list in batches.
+		 * A magazine is guarded by a try-lock, so threads that happen to share a magazine never block, but simply fall
+		 * back to the global free list. If the global list runs dry, slots get stolen from other magazines,
+		 * so a slot cached by one thread is never lost for the others.
+		 */
+		template<idx_t Size, std::size_t MagazineSize, std::size_t MagazineCnt>
+		class Magazines {
+			static_assert(MagazineSize >= 2, "Magazine has to hold at least two slots");
+
+			static constexpr std::size_t batch_size = MagazineSize / 2;
+
+			struct alignas(cache_line_size) Magazine {
+				std::atomic_flag busy = ATOMIC_FLAG_INIT;
+				std::size_t cnt = 0;
+				std::array<std::uint32_t, MagazineSize> slots;
+
+				bool try_lock() noexcept { return !busy.test_and_set(std::memory_order_acquire); }
+				void unlock() noexcept { busy.clear(std::memory_order_release); }
+			};
+
+			FreeList<Size> global;
+			std::array<Magazine, MagazineCnt> magazines;
+
+			Magazine& local() noexcept { return magazines[this_thread_index() % MagazineCnt]; }
+
+			void refill(Magazine& m) noexcept
+			{
+				while (m.cnt < batch_size) {
+					const auto idx = global.pop();
+					if (idx < 0) {
+						return;
+					}
+					m.slots[m.cnt++] = static_cast<std::uint32_t>(idx);
+				}
+			}
+
+			idx_t steal() noexcept
+			{
+				NoProbe probe;
+				return steal(probe);
+			}
+			template<class Probe>
+			idx_t steal(Probe& probe) noexcept
+			{
+				for (auto& m : magazines) {
+					probe.scanned(1);
+					if (!m.try_lock()) {
+						continue;
+					}
+					idx_t idx = -1;
+					if (m.cnt > 0) {
+						idx = m.slots[--m.cnt];
+					}
+					m.unlock();
+					if (idx >= 0) {
+						return idx;
+					}
+				}
+				return -1;
+			}
+
+		public:
+			// returns -1 if there is no free slot left
+			idx_t pop() noexcept
+			{
+				NoProbe probe;
+				return pop(probe);
+			}
+			template<class Probe>
+			idx_t pop(Probe& probe) noexcept
+			{
+				auto& m = local();
+				if (m.try_lock()) {
+					if (m.cnt == 0) {
+						refill(m);
+					}
+					idx_t idx = -1;
+					if (m.cnt > 0) {
+						idx = m.slots[--m.cnt];
+					}
+					m.unlock();
+					if (idx >= 0) {
+						return idx;
+					}
+				}
+				const auto idx = global.pop(probe);
+				return idx >= 0 ? idx : steal(probe);
+			}
+
+			// empties the local magazine first, then takes the rest from the global list (or other magazines)
+			std::size_t pop_n(std::uint32_t* out, std::size_t cnt) noexcept
+			{
+				std::size_t n = 0;
+				auto&       m = local();
+				if (m.try_lock()) {
+					while (n < cnt && m.cnt > 0) {
+						out[n++] = m.slots[--m.cnt];
+					}
+					m.unlock();
+				}
+				n += global.pop_n(out + n, cnt - n);
+				while (n < cnt) {
+					const auto idx = steal();
+					if (idx < 0) {
+						break;
+					}
+					out[n++] = static_cast<std::uint32_t>(idx);
+				}
+				return n;
+			}
+
+			void push(idx_t idx) noexcept
+			{
+				auto& m = local();
+				if (m.try_lock()) {
+					if (m.cnt == MagazineSize) {
+						// hand the older half back, keep the recently freed ones
+						global.push_n(m.slots.data(), batch_size);
+						std::copy(m.slots.begin() + batch_size, m.slots.end(), m.slots.begin());
+						m.cnt -= batch_size;
+					}
+					m.slots[m.cnt++] = static_cast<std::uint32_t>(idx);
+					// seq_cst, as this publishes the slot to sleeping creates (see ReleaseSignal)
+					m.busy.clear(std::memory_order_seq_cst);
+					return;
+				}
+				global.push(idx);
+			}
+		};
+
+		inline int countr_zero(std::uint64_t v) noexcept
+		{
+			assert(v != 0);
+#if defined(_MSC_VER)
+			unsigned long idx = 0;
+			_BitScanForward64(&idx, v);
+			return static_cast<int>(idx);
+#else
+			return __builtin_ctzll(v);
+#endif
+		}
+
+		inline int popcount(std::uint64_t v) noexcept
+		{
+#if defined(_MSC_VER)
+			return static_cast<int>(__popcnt64(v));
+#else
+			return __builtin_popcountll(v);
+#endif
+		}
+
+		/*
+		 * Two level bitmap of free slots (a set bit means free).
+		 * Every leaf word covers 64 slots and every summary word has a bit per leaf, which is set if that leaf
+		 * (probably) has a free slot. Searching a free slot therefore only touches a few words instead of the slots
+		 * themselves. The summary is only a hint: Claiming clears the summary bit of a leaf that became empty and
+		 * re-checks the leaf afterwards, releasing into an empty leaf sets it again.
+		 */
+		template<idx_t Size>
+		class Bitmap {
+			static_assert(Size > 0, "Bitmap needs at least one slot");
+
+			static constexpr idx_t leaf_cnt    = (Size + 63) / 64;
+			static constexpr idx_t summary_cnt = (leaf_cnt + 63) / 64;
+
+			static_assert(sizeof(std::atomic<std::uint64_t>) == sizeof(std::uint64_t), "Summary is scanned as plain words");
+
+			alignas(cache_line_size) std::array<std::atomic<std::uint64_t>, summary_cnt> summary;
+			alignas(cache_line_size) std::array<std::atomic<std::uint64_t>, leaf_cnt> leaves;
+
+			static constexpr std::uint64_t bit(idx_t i) noexcept { return std::uint64_t{ 1 } << (i % 64); }
+
+			// index of the first summary word >= start that has any bit set or summary_cnt
+			idx_t next_summary(idx_t start) const noexcept
+			{
+				idx_t i = start;
+#if defined(__AVX2__)
+				// Racy vector read, which is fine, as it only serves to skip empty words and every hit is re-read atomically
+				for (; i + 4 <= summary_cnt; i += 4) {
+					const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&summary[i]));
+					if (!_mm256_testz_si256(v, v)) {
+						break;
+					}
+				}
+#endif
+				for (; i < summary_cnt; ++i) {
+					if (summary[i].load(std::memory_order_relaxed) != 0) {
+						return i;
+					}
+				}
+				return summary_cnt;
+			}
+
+			void clear_summary(idx_t leaf) noexcept
+			{
+				summary[leaf / 64].fetch_and(~bit(leaf));
+				if (leaves[leaf].load() != 0) {
+					summary[leaf / 64].fetch_or(bit(leaf));
+				}
+			}
+
+			// returns -1 if there is no free slot left in that leaf
+			template<class Probe>
+			idx_t claim_from(idx_t leaf, Probe& probe) noexcept
+			{
+				auto word = leaves[leaf].load();
+				while (word != 0) {
+					const auto b      = countr_zero(word);
+					const auto masked = word & ~(std::uint64_t{ 1 } << b);
+					if (leaves[leaf].compare_exchange_weak(word, masked)) {
+						if (masked == 0) {
+							clear_summary(leaf);
+						}
+						return leaf * 64 + b;
+					}
+					probe.cas_failed();
+				}
+				clear_summary(leaf);
+				return -1;
+			}
+
+			// claims the lowest (up to) cnt free slots of that leaf with a single CAS
+			std::size_t claim_n_from(idx_t leaf, std::uint32_t* out, std::size_t cnt) noexcept
+			{
+				auto word = leaves[leaf].load();
+				while (word != 0) {
+					auto take = word;
+					if (static_cast<std::size_t>(popcount(word)) > cnt) {
+						take = 0;
+						for (auto w = word; static_cast<std::size_t>(popcount(take)) < cnt; w &= w - 1) {
+							take |= w & (~w + 1);
+						}
+					}
+					const auto masked = word & ~take;
+					if (leaves[leaf].compare_exchange_weak(word, masked)) {
+						if (masked == 0) {
+							clear_summary(leaf);
+						}
+						std::size_t n = 0;
+						for (; take != 0; take &= take - 1) {
+							out[n++] = static_cast<std::uint32_t>(leaf * 64 + countr_zero(take));
+						}
+						return n;
+					}
+				}
+				clear_summary(leaf);
+				return 0;
+			}
+
+		public:
+			Bitmap() noexcept
+			{
+				for (idx_t i = 0; i < leaf_cnt; ++i) {
+					const idx_t bits = std::min<idx_t>(64, Size - i * 64);
+					leaves[i].store(bits == 64 ? ~std::uint64_t{ 0 } : (std::uint64_t{ 1 } << bits) - 1, std::memory_order_relaxed);
+				}
+				for (idx_t i = 0; i < summary_cnt; ++i) {
+					const idx_t bits = std::min<idx_t>(64, leaf_cnt - i * 64);
+					summary[i].store(bits == 64 ? ~std::uint64_t{ 0 } : (std::uint64_t{ 1 } << bits) - 1, std::memory_order_relaxed);
+				}
+			}
+
+			// returns the lowest free slot it could claim or -1 if there is no free slot left
+			idx_t pop() noexcept
+			{
+				NoProbe probe;
+				return pop(probe);
+			}
+			// every leaf that gets searched counts as a scan step
+			template<class Probe>
+			idx_t pop(Probe& probe) noexcept
+			{
+				for (idx_t s = next_summary(0); s < summary_cnt; s = next_summary(s + 1)) {
+					auto word = summary[s].load(std::memory_order_relaxed);
+					while (word != 0) {
+						const idx_t leaf = s * 64 + countr_zero(word);
+						probe.scanned(1);
+						const auto  idx  = claim_from(leaf, probe);
+						if (idx >= 0) {
+							return idx;
+						}
+						word &= ~bit(leaf);
+					}
+				}
+				return -1;
+			}
+
+			// claims whole runs of a leaf at once, so the slots of a batch end up next to each other
+			std::size_t pop_n(std::uint32_t* out, std::size_t cnt) noexcept
+			{
+				std::size_t n = 0;
+				for (idx_t s = next_summary(0); s < summary_cnt && n < cnt; s = next_summary(s + 1)) {
+					auto word = summary[s].load(std::memory_order_relaxed);
+					while (word != 0 && n < cnt) {
+						const idx_t leaf = s * 64 + countr_zero(word);
+						n += claim_n_from(leaf, out + n, cnt - n);
+						word &= ~bit(leaf);
+					}
+				}
+				return n;
+			}
+
+			void push(idx_t idx) noexcept
+			{
+				assert(0 <= idx && idx < Size);
+				const idx_t leaf = idx / 64;
+				if (leaves[leaf].fetch_or(bit(idx)) == 0) {
+					summary[leaf / 64].fetch_or(bit(leaf));
+				}
+			}
+		};
+
+		/*
+		 * Lock-free stack of slots whose objects still have to be destroyed.
+		 * Collectors always take the whole stack at once, so (unlike the free list) it doesn't have to be ABA-safe.
+		 */
+		template<idx_t Size>
+		class RetireList {
+			static constexpr std::uint32_t nil = std::numeric_limits<std::uint32_t>::max();
+
+			alignas(cache_line_size) std::atomic<std::uint32_t> head{ nil };
+			std::atomic<idx_t> cnt{ 0 };
+			// only written by the thread that pushes the slot and only read after the stack was taken
+			alignas(cache_line_size) std::array<std::uint32_t, Size> next;
+
+		public:
+			// returns the number of retired slots including this one
+			idx_t push(idx_t idx) noexcept
+			{
+				assert(0 <= idx && idx < Size);
+				auto old = head.load(std::memory_order_relaxed);
+				do {
+					next[idx] = old;
+				} while (!head.compare_exchange_weak(old, static_cast<std::uint32_t>(idx), std::memory_order_release, std::memory_order_relaxed));
+				return cnt.fetch_add(1, std::memory_order_relaxed) + 1;
+			}
+
+			// calls f(idx) for every slot retired so far and returns their number
+			template<class F>
+			idx_t take_all(F&& f) noexcept
+			{
+				if (head.load(std::memory_order_relaxed) == nil) {
+					return 0;
+				}
+				auto  idx = head.exchange(nil, std::memory_order_acquire);
+				idx_t n   = 0;
+				while (idx != nil) {
+					// f hands the slot back, after which it may get retired (and next overwritten) again
+					const auto succ = next[idx];
+					f(idx);
+					idx = succ;
+					++n;
+				}
+				cnt.fetch_sub(n, std::memory_order_relaxed);
+				return n;
+			}
+
+			idx_t size_approx() const noexcept { return cnt.load(std::memory_order_relaxed); }
+		};
+		struct NoRetireList {};
+
+		/*
+		 * Number of claimed slots, split into cache line padded shards. A thread only ever updates the shard of its
+		 * this_thread_index(), so keeping count doesn't add a contention point. A slot can be released by another
+		 * thread than the one that claimed it, so only the sum of the shards means anything.
+		 * get() is O(Shards), but not a snapshot: It can be off by the number of claims and releases that overlap with
+		 * the call (each of them is either already counted or not) and is exact whenever the store is quiescent.
+		 */
+		template<std::size_t Shards>
+		class OccupancyCounter {
+			struct alignas(cache_line_size) Shard {
+				std::atomic<idx_t> value{ 0 };
+			};
+			std::array<Shard, Shards> shards;
+
+		public:
+			void add(idx_t n) noexcept { shards[this_thread_index() % Shards].value.fetch_add(n, std::memory_order_relaxed); }
+			void sub(idx_t n) noexcept { shards[this_thread_index() % Shards].value.fetch_sub(n, std::memory_order_relaxed); }
+
+			idx_t get() const noexcept
+			{
+				idx_t sum = 0;
+				for (const auto& shard : shards) {
+					sum += shard.value.load(std::memory_order_relaxed);
+				}
+				return sum;
+			}
+		};
+
+		/*
+		 * Lets threads sleep until a slot got released.
+		 * Releasing threads only pay for an additional load (of a cache line that isn't written) as long as nobody waits.
+		 * That relies on the engines publishing a released slot with a seq_cst operation (the CAS of the free list,
+		 * the fetch_or of the bitmap): Together with the fence in prepare_wait, either the releasing thread sees
+		 * the waiter or the waiter finds the slot.
+		 */
+		class ReleaseSignal {
+			alignas(cache_line_size) std::atomic<std::uint32_t> epoch{ 0 };
+			std::atomic<std::uint32_t> waiters{ 0 };
+#if !defined(__linux__)
+			std::mutex              mtx;
+			std::condition_variable cv;
+#endif
+
+		public:
+			void notify_one() noexcept
+			{
+				if (waiters.load(std::memory_order_seq_cst) == 0) {
+					return;
+				}
+				epoch.fetch_add(1);
+#if defined(__linux__)
+				syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&epoch), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#else
+				{ std::lock_guard<std::mutex> lock(mtx); }
+				cv.notify_one();
+#endif
+			}
+
+			// Registers a waiter. Anything released after this call changes the returned epoch
+			std::uint32_t prepare_wait() noexcept
+			{
+				waiters.fetch_add(1);
+				// pairs with the seq_cst push of the releasing thread, so the following search sees its slot
+				// if notify_one didn't see this waiter
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				return epoch.load();
+			}
+
+			// Unregisters the waiter. If it didn't get a slot despite being woken up, the wake up is passed on
+			void finish_wait(std::uint32_t observed, bool success) noexcept
+			{
+				waiters.fetch_sub(1);
+				if (!success && epoch.load() != observed) {
+					notify_one();
+				}
+			}
+
+			// Sleeps until the epoch differs from old or the timeout expired (spurious wake ups are possible)
+			void wait(std::uint32_t old, std::chrono::nanoseconds timeout) noexcept
+			{
+				if (timeout.count() <= 0) {
+					return;
+				}
+#if defined(__linux__)
+				const auto secs = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+				timespec   ts{};
+				ts.tv_sec  = static_cast<decltype(ts.tv_sec)>(secs.count());
+				ts.tv_nsec = static_cast<decltype(ts.tv_nsec)>((timeout - secs).count());
+				syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&epoch), FUTEX_WAIT_PRIVATE, old, &ts, nullptr, 0);
+#else
+				std::unique_lock<std::mutex> lock(mtx);
+				cv.wait_for(lock, timeout, [&] { return epoch.load() != old; });
+#endif
+			}
+		};
+
+		struct alloc_policy {};
+		struct layout_policy {};
+		struct reclaim_policy {};
+		struct refcount_policy {};
+		struct recycle_policy {};
+		struct stats_policy {};
+
+		// Picks the first policy in Policies that belongs to Category (i.e. is derived from it) or Default if there is none
+		template<class Category, class Default, class ... Policies>
+		struct select_policy {
+			using type = Default;
+		};
+		template<class Category, class Default, class First, class ... Rest>
+		struct select_policy<Category, Default, First, Rest...> {
+			using type = std::conditional_t<
+				std::is_base_of_v<Category, First>,
+				First,
+				typename select_policy<Category, Default, Rest...>::type>;
+		};
+		template<class Category, class Default, class ... Policies>
+		using select_policy_t = typename select_policy<Category, Default, Policies...>::type;
+	}
+
+	/*
+	 * Allocation policies, which can be passed as additional template parameters to SharedObjectStore
+	 */
+	namespace alloc {
+		// Single, global lock-free free list (default)
+		struct free_list : detail::alloc_policy {
+			template<idx_t Size>
+			using engine = detail::FreeList<Size>;
+		};
+
+		// Global free list plus per-thread caches of MagazineSize free slots.
+		// Creates and releases on the same thread mostly don't touch shared cache lines.
+		template<std::size_t MagazineSize = 32, std::size_t MagazineCnt = 64>
+		struct magazines : detail::alloc_policy {
+			template<idx_t Size>
+			using engine = detail::Magazines<Size, MagazineSize, MagazineCnt>;
+		};
+
+		// Two level occupancy bitmap searched with ctz (and AVX2 where available).
+		// Always hands out the lowest free slot.
+		struct bitmap : detail::alloc_policy {
+			template<idx_t Size>
+			using engine = detail::Bitmap<Size>;
+		};
+	}
+
+	// How handles count their references
+	namespace refcount {
+		// Every copy and drop of a handle is an atomic operation on the refcount of the slot (default)
+		struct atomic : detail::refcount_policy {
+			static constexpr std::uint32_t batch = 0;
+		};
+		/*
+		 * Copies and drops go through a per-thread cache of spare references (taken from the slot Batch at a time), so
+		 * threads that keep copying handles to the same hot object don't fight over its refcount.
+		 * Objects are destroyed once all threads handed their spares back, which can take until the next periodic flush
+		 * (see sos::flush_thread_refs()). A store hands back the spares of all threads before it gives up on a create
+		 * (or grows / commits another segment) and on flush_refs(). Modifiable handles never use the cache.
+		 * unique() ignores the spares of the calling thread, but counts those of other threads. try_upgrade() hands back
+		 * the spares of all threads for its object before giving up.
+		 * Only supported by the interleaved layout.
+		 */
+		template<std::uint32_t Batch = 16>
+		struct biased : detail::refcount_policy {
+			static_assert(Batch > 0, "Batch has to be at least one");
+			static constexpr std::uint32_t batch = Batch;
+		};
+	}
+
+	// Hands all spare references the calling thread caches for stores with sos::refcount::biased back
+	inline void flush_thread_refs() noexcept
+	{
+		if (auto* cache = detail::RefCache::local()) {
+			cache->flush();
+		}
+	}
+
+	namespace detail {
+		template<class T, class = void>
+		struct has_reset : std::false_type {};
+		template<class T>
+		struct has_reset<T, std::void_t<decltype(std::declval<T&>().reset())>> : std::true_type {};
+
+		template<class Void, class T, class ... ARGS>
+		struct has_reinit : std::false_type {};
+		template<class T, class ... ARGS>
+		struct has_reinit<std::void_t<decltype(std::declval<T&>().reinit(std::declval<ARGS>()...))>, T, ARGS...> : std::true_type {};
+	}
+
+	/*
+	 * How sos::recycle::reuse clears and reinitializes objects.
+	 * Specialize it for types that don't have the members the defaults rely on.
+	 */
+	template<class T>
+	struct recycle_traits {
+		// Called when the last handle drops. Should free what mustn't outlive the object, but keep buffers (clear(), not shrink_to_fit())
+		static void reset(T& obj) noexcept
+		{
+			static_assert(detail::has_reset<T>::value, "sos::recycle::reuse needs T::reset() or a specialization of sos::recycle_traits<T>");
+			obj.reset();
+		}
+		/*
+		 * Turns a reset object into the one create(args...) would have constructed: Calls obj.reinit(args...) if T has it
+		 * and otherwise assigns the single argument (or a T constructed from args). Without arguments (and reinit),
+		 * the reset object is handed out as it is.
+		 */
+		template<class ... ARGS>
+		static void reinit(T& obj, ARGS&& ... args)
+		{
+			if constexpr (detail::has_reinit<void, T, ARGS&&...>::value) {
+				obj.reinit(std::forward<ARGS>(args)...);
+			} else if constexpr (sizeof...(ARGS) == 0) {
+			} else if constexpr (sizeof...(ARGS) == 1 && std::is_assignable<T&, ARGS&&...>::value) {
+				((obj = std::forward<ARGS>(args)), ...);
+			} else {
+				obj = T(std::forward<ARGS>(args)...);
+			}
+		}
 	};
 
+	// Decide what happens to an object when its last handle drops
+	namespace recycle {
+		// It gets destroyed and the next create in its slot constructs a new one (default)
+		struct destroy : detail::recycle_policy {
+			template<class T>
+			using traits = void;
+		};
+		/*
+		 * It gets reset by sos::recycle_traits<T> and stays constructed, the next create in its slot reinitializes it.
+		 * Objects owning heap memory (strings, vectors, ...) keep their buffers, so once the store has warmed up to the
+		 * working set, creating and releasing objects doesn't allocate. Kept objects are destroyed with the store.
+		 * As a slot only holds an object after its first use, create(args...) still has to be able to construct T from args.
+		 * Only supported by the interleaved layout. Use SharedObjectStore::handle_type / const_handle_type to name the handles.
+		 */
+		struct reuse : detail::recycle_policy {
+			template<class T>
+			using traits = recycle_traits<T>;
+		};
+	}
+
+	/*
+	 * Layout policies, which decide where the refcounts live relative to the objects
+	 */
+	namespace layout {
+		// Refcount right next to its object (default)
+		struct interleaved : detail::layout_policy {
+			template<class T, idx_t Size, class Refcount = refcount::atomic, class Recycle = recycle::destroy>
+			using slots = detail::InterleavedSlots<T, Size, detail::Slot<T, Refcount::batch, typename Recycle::template traits<T>>>;
+		};
+
+		// Refcounts in an array of their own, RefsPerLine of them per cache line (1 == one cache line each).
+		// The objects are densely packed in a separate array, so handles to different objects don't share cache lines
+		// for refcounting. Use SharedObjectStore::handle_type / const_handle_type to name the handles of such a store.
+		template<std::size_t RefsPerLine = 1>
+		struct split : detail::layout_policy {
+			template<class T, idx_t Size, class Refcount = refcount::atomic, class Recycle = recycle::destroy>
+			using slots = std::enable_if_t<Refcount::batch == 0 && std::is_same<Recycle, recycle::destroy>::value, detail::SplitSlots<T, Size, RefsPerLine>>;
+		};
+	}
+
 	namespace detail {
+		// The slot array selected by the layout, refcount and recycle policies
+		template<class T, idx_t Size, class ... Policies>
+		using slots_t = typename select_policy_t<layout_policy, layout::interleaved, Policies...>::template slots<
+			T, Size, select_policy_t<refcount_policy, refcount::atomic, Policies...>,
+			select_policy_t<recycle_policy, recycle::destroy, Policies...>>;
+	}
 
-		template<class T>
-		class Slot {
-			std::aligned_storage_t<sizeof(T), alignof(T)> data{};
-			std::atomic_int ref_cnt{ 0 };
+	// Decide on which thread the objects get destroyed
+	namespace reclaim {
+		// The thread that drops the last reference destroys the object right away (default)
+		struct immediate : detail::reclaim_policy {
+			static constexpr bool  is_deferred = false;
+			static constexpr idx_t max_backlog = 0;
+		};
+		/*
+		 * Dropping the last reference only pushes the slot onto a retire list. The objects get destroyed (and their slots
+		 * freed) by collect(), e.g. from a sos::Reclaimer thread. To not starve the store, a releasing thread collects
+		 * by itself once more than MaxBacklog objects are waiting and a create that finds no free slot collects, too.
+		 */
+		template<idx_t MaxBacklog = 4096>
+		struct deferred : detail::reclaim_policy {
+			static_assert(MaxBacklog > 0, "The backlog needs room for at least one object");
+			static constexpr bool  is_deferred = true;
+			static constexpr idx_t max_backlog = MaxBacklog;
+		};
+	}
 
-		public:
-			template<class ... ARGS>
-			bool try_create(ARGS&& ... args) {
-				int i = 0;
-				if (ref_cnt.compare_exchange_strong(i, 1)) {
-					new(&data) T(std::forward<ARGS>(args)...);
-					return true;
+	// Snapshot of the counters of a store with the sos::stats::counters policy (see SharedObjectStore::stats())
+	struct store_stats {
+		std::uint64_t creates         = 0; // objects created
+		std::uint64_t create_failures = 0; // attempts that found no free slot (try_create, every retry of create)
+		std::uint64_t releases        = 0; // slots handed back to the store
+		std::uint64_t cas_retries     = 0; // failed CAS while claiming a free slot
+		std::uint64_t scan_steps      = 0; // bitmap leaves or foreign magazines searched for a free slot
+		std::uint64_t yields          = 0; // times create yielded because the store was full
+		std::uint64_t waits           = 0; // times create_wait went to sleep
+		std::uint64_t bad_allocs      = 0; // sos::bad_alloc errors raised
+		std::uint64_t collected       = 0; // objects destroyed by collect() (deferred reclamation)
+		idx_t         live            = 0; // claimed slots (including retired objects)
+		idx_t         live_high_water = 0; // maximum of live so far (sampled, see sos::stats::counters)
+		idx_t         capacity        = 0;
+	};
+
+	namespace detail {
+		enum class stat : std::size_t { creates, create_failures, releases, cas_retries, scan_steps, yields, waits, bad_allocs, collected };
+		constexpr std::size_t stat_cnt = static_cast<std::size_t>(stat::collected) + 1;
+
+		// Counters of a store without statistics: Nothing is counted (or even stored)
+		struct NoStats {
+			struct Local : NoProbe {
+				void add(stat, std::uint64_t = 1) noexcept {}
+			};
+
+			Local local() noexcept { return {}; }
+			template<class LiveFn>
+			void claimed(idx_t, LiveFn&&) noexcept {}
+			template<class LiveFn>
+			void sample(LiveFn&&) noexcept {}
+		};
+
+		/*
+		 * Counters of a store, spread over Stripes cache lines. Every thread counts in the stripe of its
+		 * this_thread_index(), so threads only share a line if there are more of them than stripes.
+		 * The live count comes from the store's occupancy counter. The high water mark is sampled from it every
+		 * sample_interval claims of a stripe, on every batch and whenever a create finds the store full, so it is only
+		 * written when it actually grows.
+		 */
+		template<std::size_t Stripes>
+		class StripedStats {
+			static constexpr std::uint64_t sample_interval = 16;
+
+			struct alignas(cache_line_size) Stripe {
+				std::array<std::atomic<std::uint64_t>, stat_cnt> values{};
+				std::atomic<std::uint64_t>                        claims{ 0 };
+
+				void add(stat s, std::uint64_t n = 1) noexcept { values[static_cast<std::size_t>(s)].fetch_add(n, std::memory_order_relaxed); }
+				void cas_failed() noexcept { add(stat::cas_retries); }
+				void scanned(idx_t n) noexcept { add(stat::scan_steps, static_cast<std::uint64_t>(n)); }
+			};
+
+			std::array<Stripe, Stripes> stripes;
+			alignas(cache_line_size) std::atomic<idx_t> high_water{ 0 };
+
+			void raise_high_water(idx_t now) noexcept
+			{
+				auto max = high_water.load(std::memory_order_relaxed);
+				while (now > max && !high_water.compare_exchange_weak(max, now, std::memory_order_relaxed)) {
 				}
-				return false;
 			}
-			void add_ref() noexcept {
-				ref_cnt.fetch_add(1,std::memory_order_relaxed);
+
+		public:
+			Stripe& local() noexcept { return stripes[this_thread_index() % Stripes]; }
+
+			// live() returns the current number of live objects
+			template<class LiveFn>
+			void claimed(idx_t n, LiveFn&& live) noexcept
+			{
+				const auto before = local().claims.fetch_add(static_cast<std::uint64_t>(n), std::memory_order_relaxed);
+				if (n > 1 || before % sample_interval == 0) {
+					raise_high_water(live());
+				}
 			}
-			void remove_ref() noexcept {
-				assert(ref_cnt > 1);
-				if (ref_cnt.fetch_sub(1) == 2) {
-					object()->~T();
-					ref_cnt = 0;
+			template<class LiveFn>
+			void sample(LiveFn&& live) noexcept { raise_high_water(live()); }
+
+			store_stats snapshot(idx_t live) const noexcept
+			{
+				std::array<std::uint64_t, stat_cnt> sum{};
+				for (const auto& stripe : stripes) {
+					for (std::size_t i = 0; i < stat_cnt; ++i) {
+						sum[i] += stripe.values[i].load(std::memory_order_relaxed);
+					}
 				}
+				store_stats result;
+				result.creates         = sum[static_cast<std::size_t>(stat::creates)];
+				result.create_failures = sum[static_cast<std::size_t>(stat::create_failures)];
+				result.releases        = sum[static_cast<std::size_t>(stat::releases)];
+				result.cas_retries     = sum[static_cast<std::size_t>(stat::cas_retries)];
+				result.scan_steps      = sum[static_cast<std::size_t>(stat::scan_steps)];
+				result.yields          = sum[static_cast<std::size_t>(stat::yields)];
+				result.waits           = sum[static_cast<std::size_t>(stat::waits)];
+				result.bad_allocs      = sum[static_cast<std::size_t>(stat::bad_allocs)];
+				result.collected       = sum[static_cast<std::size_t>(stat::collected)];
+				result.live            = live;
+				result.live_high_water = std::max(high_water.load(std::memory_order_relaxed), live);
+				return result;
 			}
-			T* object() noexcept { return std::launder(reinterpret_cast<T*>(&data)); }
+		};
+	}
 
-			bool is_free() const noexcept { return ref_cnt.load(std::memory_order_relaxed) == 0; }
-			bool is_uniquely_owned() const noexcept { return ref_cnt == 2; }
+	// Statistics policies: whether a store counts what it does (see SharedObjectStore::stats())
+	namespace stats {
+		// Nothing is counted (default)
+		struct none : detail::stats_policy {
+			static constexpr bool enabled = false;
+			using counters_type           = detail::NoStats;
+		};
+		/*
+		 * Counts creates, failed CAS, scan steps, yields, waits, bad_allocs, ... in counters striped by thread.
+		 * Only supported by SharedObjectStore.
+		 */
+		template<std::size_t Stripes = 64>
+		struct counters : detail::stats_policy {
+			static_assert(Stripes > 0, "Need at least one stripe");
+			static constexpr bool enabled = true;
+			using counters_type           = detail::StripedStats<Stripes>;
 		};
+	}
+
+	namespace detail {
 
-		template<class T, idx_t Size>
-		class Store {
+		template<class Slots, class Engine, class Reclaim = reclaim::immediate, class Stats = stats::none>
+		class Store : public Slots::slot_type::pool_type {
 		public:
-			std::array<T, Size> data;
-			std::atomic<std::size_t> last_next = { 0 };
-			auto next_free_slot() noexcept {
-				const auto start = data.begin()+last_next.load();
-				auto pos = std::find_if(start, data.end(), [](auto&& s) {return s.is_free(); });
-				if (pos != data.end())
-				{
-					return pos;
+			using slot_type = typename Slots::slot_type;
+
+			Slots data;
+
+			Store() noexcept
+				: Slots::slot_type::pool_type(Reclaim::is_deferred)
+			{
+				data.bind(*this);
+			}
+			Store(const Store&) = delete;
+			Store& operator=(const Store&) = delete;
+			~Store()
+			{
+				flush_refs();
+				collect();
+				if constexpr (slot_type::recycles) {
+					for (idx_t i = 0; i < Slots::size; ++i) {
+						data[i].discard();
+					}
+				}
+			}
+
+			// returns nullptr (without touching args) if there is no free slot
+			template<class ... ARGS>
+			slot_type* try_emplace(ARGS&& ... args)
+			{
+				auto&& local = counters.local();
+				auto   idx   = free_slots.pop(local);
+				if (idx < 0 && collect() > 0) {
+					idx = free_slots.pop(local);
+				}
+				if (idx < 0) {
+					local.add(stat::create_failures);
+					counters.sample([this] { return live_count_approx(); });
+					return nullptr;
 				}
+				occupied.add(1);
+				counters.claimed(1, [this] { return live_count_approx(); });
+				auto& slot = data[idx];
+				[[maybe_unused]] const bool success = slot.try_create(*this, std::forward<ARGS>(args)...);
+				assert(success);
+				local.add(stat::creates);
+				return &slot;
+			}
 
-				pos = std::find_if(data.begin(), start, [](auto&& s) {return s.is_free(); });
-				if (pos != start) {
-					return pos;
+			/*
+			 * Claims count slots at once (all or nothing) and constructs the i-th object from factory(i).
+			 * Every constructed slot is passed to sink right away. Returns false if there aren't enough free slots.
+			 */
+			template<class Factory, class Sink>
+			bool try_emplace_n(idx_t count, Factory& factory, Sink&& sink)
+			{
+				std::vector<std::uint32_t> idxs(static_cast<std::size_t>(count));
+				auto claimed = free_slots.pop_n(idxs.data(), idxs.size());
+				if (claimed < idxs.size() && collect() > 0) {
+					claimed += free_slots.pop_n(idxs.data() + claimed, idxs.size() - claimed);
 				}
-				return data.end();
+				if (claimed < idxs.size()) {
+					give_back(idxs.data(), claimed);
+					counters.local().add(stat::create_failures);
+					return false;
+				}
+				// only a committed batch counts as live, so a failed one doesn't make the store look full
+				occupied.add(count);
+				counters.claimed(count, [this] { return live_count_approx(); });
+				std::size_t i            = 0;
+				bool        constructing = false;
+#if !defined(SOS_NO_EXCEPTIONS)
+				try {
+#endif
+					for (; i < idxs.size(); ++i) {
+						auto&  slot  = data[idxs[i]];
+						auto&& value = factory(static_cast<idx_t>(i));
+						constructing = true;
+						[[maybe_unused]] const bool success = slot.try_create(*this, std::forward<decltype(value)>(value));
+						assert(success);
+						constructing = false;
+						sink(slot);
+					}
+#if !defined(SOS_NO_EXCEPTIONS)
+				} catch (...) {
+					// a slot whose construction failed was already given back by try_create, one whose factory threw wasn't
+					const auto rest = constructing ? i + 1 : i;
+					give_back(idxs.data() + rest, idxs.size() - rest);
+					occupied.sub(static_cast<idx_t>(idxs.size() - rest));
+					counters.local().add(stat::creates, i);
+					throw;
+				}
+#endif
+				counters.local().add(stat::creates, idxs.size());
+				return true;
 			}
+
 			template<class ... ARGS>
-			T& emplace(ARGS&& ... args)
+			slot_type& emplace(ARGS&& ... args)
 			{
 				int  fail_cnt = 0;
-				auto pos = next_free_slot();
-				while( pos == data.end() || !pos->try_create( std::forward<ARGS>( args )... ) )
-				{
-					pos = next_free_slot();
-					if (pos == data.end()) {
-						std::this_thread::yield();
-					}
+				auto slot = try_emplace(std::forward<ARGS>(args)...);
+				if (slot == nullptr && flush_refs() > 0) {
+					slot = try_emplace(std::forward<ARGS>(args)...);
+				}
+				while (slot == nullptr) {
+					std::this_thread::yield();
 					fail_cnt++;
 					if (fail_cnt > 10) {
-						throw sos::bad_alloc<Store>();
+						count(stat::bad_allocs);
+						detail::raise(sos::bad_alloc<Store>());
+					}
+					count(stat::yields);
+					slot = try_emplace(std::forward<ARGS>(args)...);
+				}
+				return *slot;
+			}
+
+			// Sleeps while the store is full. Returns nullptr if there still isn't a free slot at the deadline
+			template<class Clock, class Duration, class ... ARGS>
+			slot_type* emplace_until(const std::chrono::time_point<Clock, Duration>& deadline, ARGS&& ... args)
+			{
+				if (auto* slot = try_emplace(args...)) {
+					return slot;
+				}
+				if (flush_refs() > 0) {
+					if (auto* slot = try_emplace(args...)) {
+						return slot;
+					}
+				}
+				for (;;) {
+					const auto epoch = released.prepare_wait();
+					auto*      slot  = try_emplace(args...);
+					const auto now   = Clock::now();
+					if (slot || now >= deadline) {
+						released.finish_wait(epoch, slot != nullptr);
+						return slot;
+					}
+					count(stat::waits);
+					released.wait(epoch, std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now));
+					released.finish_wait(epoch, true);
+				}
+			}
+
+			void release(slot_type& slot) noexcept override
+			{
+				free_slots.push(data.index_of(slot));
+				occupied.sub(1);
+				count(stat::releases);
+				released.notify_one();
+			}
+
+			void retire(slot_type& slot) noexcept override
+			{
+				if constexpr (Reclaim::is_deferred) {
+					if (retired.push(data.index_of(slot)) > Reclaim::max_backlog) {
+						collect();
+					}
+				} else {
+					assert(false && "Slots are only retired with deferred reclamation");
+				}
+			}
+
+			// Destroys all retired objects and returns their number
+			idx_t collect() noexcept
+			{
+				if constexpr (Reclaim::is_deferred) {
+					const auto cnt = retired.take_all([this](std::uint32_t idx) { data[idx].destroy(); });
+					if (cnt > 0) {
+						count(stat::collected, static_cast<std::uint64_t>(cnt));
 					}
+					return cnt;
+				} else {
+					return 0;
+				}
+			}
+			// Hands back the spare references all threads cache for this store (see sos::refcount::biased) and returns their number
+			std::size_t flush_refs() noexcept
+			{
+				if constexpr (slot_type::caches_refs) {
+					return RefCache::purge(&data, &data + 1);
+				} else {
+					return 0;
+				}
+			}
+			idx_t retired_count_approx() const noexcept
+			{
+				if constexpr (Reclaim::is_deferred) {
+					return retired.size_approx();
+				} else {
+					return 0;
+				}
+			}
+
+			// O(occupancy_shards), see OccupancyCounter for how stale it can be
+			idx_t free_count_approx() const noexcept { return Slots::size - live_count_approx(); }
+			idx_t live_count_approx() const noexcept { return std::clamp<idx_t>(occupied.get(), 0, Slots::size); }
+
+			// counts n events of kind s (a no-op without statistics)
+			void count(stat s, std::uint64_t n = 1) noexcept { counters.local().add(s, n); }
+			store_stats stats() const noexcept
+			{
+				static_assert(Stats::enabled, "stats() needs the sos::stats::counters policy");
+				auto result     = counters.snapshot(live_count_approx());
+				result.capacity = Slots::size;
+				return result;
+			}
+
+		protected:
+#if defined(SOS_ENABLE_TRACE)
+			std::uint32_t trace_index(const slot_type& slot) const noexcept override { return static_cast<std::uint32_t>(data.index_of(slot)); }
+#endif
+
+		private:
+			static constexpr std::size_t occupancy_shards = 8;
+
+			Engine                             free_slots;
+			ReleaseSignal                      released;
+			OccupancyCounter<occupancy_shards> occupied;
+			typename Stats::counters_type      counters;
+			std::conditional_t<Reclaim::is_deferred, RetireList<Slots::size>, NoRetireList> retired;
+
+			void give_back(const std::uint32_t* idxs, std::size_t cnt) noexcept
+			{
+				for (std::size_t i = 0; i < cnt; ++i) {
+					free_slots.push(idxs[i]);
+					released.notify_one();
 				}
-				last_next = pos - data.begin() + 1;
-				return *pos;
 			}
 		};
 	}
 
 
+	namespace detail {
+		// Lets the stores (and other library types) turn slots into handles and back without making that public
+		struct handle_access {
+			// adds a reference for the new handle
+			template<class H, class SlotT>
+			static H make(SlotT& slot) noexcept { return H(slot); }
+			// takes over a reference that is already accounted for
+			template<class H, class SlotT>
+			static H adopt(SlotT& slot) noexcept
+			{
+				H h;
+				h.ptr = &slot;
+				return h;
+			}
+			// empties the handle without dropping its reference
+			template<class H>
+			static auto* detach(H& handle) noexcept { return std::exchange(handle.ptr, nullptr); }
+			template<class H>
+			static auto* slot(const H& handle) noexcept { return handle.ptr; }
+		};
+	}
+
 	/*
 	* Note: Both ConstHandle, as well as Handle
 	* Have many constexpr member functions, constructors and operators,
 	* but they can only be used in a constexpr context when the handle is empty
 	*/
 
-	template<class T>
+	template<class T, class SlotT = detail::Slot<T>>
 	class ConstHandle;
 
 
-	template<class T>
+	template<class T, class SlotT = detail::Slot<T>>
 	class Handle {
-		template<class, idx_t>
-		friend class SharedObjectStore;
+		friend struct detail::handle_access;
 
-		template<class>
+		template<class, class>
 		friend class ConstHandle;
 
-		detail::Slot<T>* ptr = nullptr;
+		SlotT* ptr = nullptr;
 
-		Handle(detail::Slot<T>& p) noexcept
+		Handle(SlotT& p) noexcept
 			: ptr(&p)
 		{
 			assert(ptr);
@@ -185,13 +2008,14 @@ namespace mgb { namespace sos {
 			assert(ptr);
 			return ptr->is_uniquely_owned();
 		}
-		ConstHandle<T> lock() && noexcept ;
+		ConstHandle<T, SlotT> lock() && noexcept ;
 	};
 
-	template<class T>
+	template<class T, class SlotT>
 	class ConstHandle {
+		friend struct detail::handle_access;
 
-		detail::Slot<T>* ptr = nullptr;
+		SlotT* ptr = nullptr;
 
 		constexpr void dec_ref() const noexcept
 		{
@@ -217,9 +2041,13 @@ namespace mgb { namespace sos {
 			: ptr(std::exchange(other.ptr, nullptr))
 		{
 		}
-		constexpr ConstHandle( Handle<T>&& other ) noexcept
+		constexpr ConstHandle( Handle<T, SlotT>&& other ) noexcept
 			: ptr(std::exchange(other.ptr, nullptr))
 		{
+			if (ptr) {
+				ptr->ref_count().publish();
+				detail::trace(*ptr, trace_event::lock);
+			}
 		}
 		constexpr ConstHandle& operator=(const ConstHandle& other) noexcept
 		{
@@ -234,10 +2062,14 @@ namespace mgb { namespace sos {
 			ptr = std::exchange(other.ptr, nullptr);
 			return *this;
 		}
-		constexpr ConstHandle& operator=(Handle<T>&& other) noexcept
+		constexpr ConstHandle& operator=(Handle<T, SlotT>&& other) noexcept
 		{
 			dec_ref();
 			ptr = std::exchange(other.ptr, nullptr);
+			if (ptr) {
+				ptr->ref_count().publish();
+				detail::trace(*ptr, trace_event::lock);
+			}
 			return *this;
 		}
 		const T* operator->() const noexcept
@@ -262,47 +2094,420 @@ namespace mgb { namespace sos {
 
 		constexpr bool empty() const noexcept
 		{
-			return ptr != nullptr;
+			return ptr == nullptr;
 		}
 		constexpr bool unique() const noexcept
 		{
 			assert(ptr);
 			return ptr->is_uniquely_owned();
 		}
-		Handle<T> turn_into_modifiable_handle() &&
+		/*
+		 * Returns a modifiable handle to the object if this is the only handle to it (checked and taken over with a single
+		 * CAS, so it can't race with copies made through weak handles, ids or visitors) and an empty one otherwise.
+		 * Only on success, this handle is empty afterwards. Invalidates all weak handles to the object.
+		 */
+		Handle<T, SlotT> try_upgrade() && noexcept
+		{
+			assert(ptr);
+			bool exclusive = ptr->ref_count().try_make_exclusive();
+			if constexpr (SlotT::caches_refs) {
+				// spares cached by any thread would count as other references
+				if (!exclusive && detail::RefCache::purge(ptr, ptr + 1) > 0) {
+					exclusive = ptr->ref_count().try_make_exclusive();
+				}
+			}
+			if (!exclusive) {
+				return {};
+			}
+			detail::trace(*ptr, trace_event::unlock);
+			return detail::handle_access::adopt<Handle<T, SlotT>>(*std::exchange(ptr, nullptr));
+		}
+		// Like try_upgrade, but throws if this isn't the only handle to the object
+		Handle<T, SlotT> turn_into_modifiable_handle() &&
 		{
-			if (!unique()) {
-				throw std::runtime_error("Could not turn const handle into modifiable handle, as const handle wasn't unique owner of resource");
+			auto handle = std::move(*this).try_upgrade();
+			if (handle.empty()) {
+				detail::raise(std::runtime_error("Could not turn const handle into modifiable handle, as const handle wasn't unique owner of resource"));
 			}
-			return Handle<T>(std::exchange(ptr, nullptr));
+			return handle;
 		}
 	};
 
-	template<class T>
-	ConstHandle<T> Handle<T>::lock() && noexcept
+	/*
+	 * Refers to an object without keeping it alive. lock() returns a const handle to the object if it still exists
+	 * (and an empty one otherwise). A slot that got reused for another object is detected by its generation.
+	 * Weak handles can only be made from const handles, and turning a const handle back into a modifiable one
+	 * invalidates them, so lock() never hands out a reference to an object someone may be modifying.
+	 * The slot itself has to stay accessible, i.e. don't decommit (VirtualObjectStore::decommit_idle) segments while
+	 * weak handles into them exist.
+	 */
+	template<class T, class SlotT = detail::Slot<T>>
+	class WeakHandle {
+		SlotT*        ptr = nullptr;
+		std::uint32_t gen = 0;
+
+	public:
+		constexpr WeakHandle() noexcept = default;
+		WeakHandle(const ConstHandle<T, SlotT>& handle) noexcept
+			: ptr(detail::handle_access::slot(handle))
+			, gen(ptr ? ptr->ref_count().generation() : 0)
+		{
+		}
+
+		ConstHandle<T, SlotT> lock() const noexcept
+		{
+			if (ptr && ptr->ref_count().try_add(gen)) {
+				detail::trace(*ptr, trace_event::acquire);
+				return detail::handle_access::adopt<ConstHandle<T, SlotT>>(*ptr);
+			}
+			return {};
+		}
+		// true if lock() would (currently) fail
+		bool expired() const noexcept { return !ptr || !ptr->ref_count().is_alive(gen); }
+
+		void reset() noexcept { ptr = nullptr; }
+		constexpr bool empty() const noexcept { return ptr == nullptr; }
+	};
+
+	template<class T, class SlotT>
+	ConstHandle<T, SlotT> Handle<T, SlotT>::lock() && noexcept
 	{
 		assert(ptr);
-		return ConstHandle<T>(std::move(*this));
+		return ConstHandle<T, SlotT>(std::move(*this));
+	}
+
+	/*
+	 * Copy on write: Upgrades handle in place if it is the only handle to its object (without allocating) and otherwise
+	 * creates a copy of the object in store and drops handle. If creating the copy fails (e.g. the store is full),
+	 * handle is left untouched. Works with every store whose handles are of this type.
+	 */
+	template<class Store, class T, class SlotT>
+	Handle<T, SlotT> make_mutable(Store& store, ConstHandle<T, SlotT>&& handle)
+	{
+		static_assert(std::is_same<typename Store::handle_type, Handle<T, SlotT>>::value, "handle has to be one of store's handles");
+		if (auto upgraded = std::move(handle).try_upgrade(); !upgraded.empty()) {
+			return upgraded;
+		}
+		auto copy = store.create(*handle);
+		handle    = ConstHandle<T, SlotT>{};
+		return copy;
 	}
 
-	template<class T, idx_t Size>
+	template<class Store>
+	class HandleVector;
+	template<class Store, class Handle>
+	class HandleQueue;
+
+	namespace detail {
+		constexpr int bit_width(std::uint64_t v) noexcept { return v == 0 ? 0 : 1 + bit_width(v >> 1); }
+	}
+
+	/*
+	 * Compact id of an object in a SharedObjectStore with Size slots: the slot index and the low bits of the slot's
+	 * generation packed into 16 bit (fewer than 1024 slots), 32 bit (fewer than 2^26 slots) or 64 bit.
+	 * The store resolves an id to a handle and detects ids of objects that don't exist any more by the generation
+	 * (which can only be fooled if the slot got reused a multiple of 2^generation_bits times in between).
+	 * The default constructed id (raw value 0) is empty.
+	 */
+	template<idx_t Size>
+	class ObjectId {
+	public:
+		static constexpr int index_bits = detail::bit_width(static_cast<std::uint64_t>(Size));
+
+		using rep_type = std::conditional_t<(index_bits <= 10), std::uint16_t, std::conditional_t<(index_bits <= 26), std::uint32_t, std::uint64_t>>;
+
+		static constexpr int generation_bits = static_cast<int>(sizeof(rep_type) * 8) - index_bits;
+		static constexpr std::uint32_t generation_mask = generation_bits >= 32 ? ~std::uint32_t{ 0 } : (std::uint32_t{ 1 } << generation_bits) - 1;
+
+		constexpr ObjectId() noexcept = default;
+
+		constexpr bool empty() const noexcept { return value == 0; }
+		constexpr rep_type raw() const noexcept { return value; }
+		static constexpr ObjectId from_raw(rep_type raw) noexcept { return ObjectId(raw); }
+
+		friend constexpr bool operator==(ObjectId l, ObjectId r) noexcept { return l.value == r.value; }
+		friend constexpr bool operator!=(ObjectId l, ObjectId r) noexcept { return l.value != r.value; }
+
+	private:
+		template<class, idx_t, class ...>
+		friend class SharedObjectStore;
+
+		static constexpr rep_type index_mask = static_cast<rep_type>((rep_type{ 1 } << index_bits) - 1);
+
+		rep_type value = 0;
+
+		constexpr explicit ObjectId(rep_type raw) noexcept
+			: value(raw)
+		{
+		}
+		// the index is stored with an offset of one, so 0 can mean empty
+		constexpr ObjectId(idx_t index, std::uint32_t generation) noexcept
+			: value(static_cast<rep_type>((static_cast<rep_type>(generation & generation_mask) << index_bits) | static_cast<rep_type>(index + 1)))
+		{
+		}
+		constexpr idx_t index() const noexcept { return static_cast<idx_t>(value & index_mask) - 1; }
+		constexpr std::uint32_t generation() const noexcept { return static_cast<std::uint32_t>(value >> index_bits); }
+	};
+
+	/*
+	 * Policies (e.g. from sos::alloc) can be passed in any order after the size
+	 */
+	template<class T, idx_t Size, class ... Policies>
 	class SharedObjectStore {
+		using alloc_policy   = detail::select_policy_t<detail::alloc_policy, alloc::free_list, Policies...>;
+		using reclaim_policy = detail::select_policy_t<detail::reclaim_policy, reclaim::immediate, Policies...>;
+		using stats_policy   = detail::select_policy_t<detail::stats_policy, stats::none, Policies...>;
+
+		using slots_type = detail::slots_t<T, Size, Policies...>;
+		using store_type = detail::Store<slots_type, typename alloc_policy::template engine<Size>, reclaim_policy, stats_policy>;
+
+		friend class HandleVector<SharedObjectStore>;
+		template<class, class>
+		friend class HandleQueue;
+
 	public:
+		using value_type        = T;
+		using slot_type         = typename slots_type::slot_type;
+		using handle_type       = Handle<T, slot_type>;
+		using const_handle_type = ConstHandle<T, slot_type>;
+		using weak_handle_type  = WeakHandle<T, slot_type>;
+		using id_type           = ObjectId<Size>;
+
 		template<class ... ARGS>
-		[[nodiscard]] Handle<T> create(ARGS&& ... args) {
-			return { store.emplace(args...) };
+		[[nodiscard]] handle_type create(ARGS&& ... args) {
+			return detail::handle_access::make<handle_type>(store.emplace(args...));
+		}
+		// Like create, but returns an empty handle instead of throwing (or retrying) if the store is full
+		template<class ... ARGS>
+		[[nodiscard]] handle_type try_create(ARGS&& ... args) {
+			auto* slot = store.try_emplace(args...);
+			if (slot == nullptr && store.flush_refs() > 0) {
+				slot = store.try_emplace(args...);
+			}
+			return slot ? detail::handle_access::make<handle_type>(*slot) : handle_type{};
+		}
+
+		/*
+		 * Creates count objects at once, the i-th one constructed from factory(i) (which may return a T or anything
+		 * a T can be constructed from). The slots are claimed in one go, so they tend to be adjacent.
+		 * All or nothing: Fails like create if there aren't count free slots and destroys the already created objects
+		 * if a constructor throws.
+		 */
+		template<class Factory>
+		[[nodiscard]] std::vector<handle_type> create_n(idx_t count, Factory&& factory) {
+			auto handles = try_create_n(count, factory);
+			for (int fail_cnt = 0; static_cast<idx_t>(handles.size()) < count; ++fail_cnt) {
+				if (fail_cnt >= 10) {
+					store.count(detail::stat::bad_allocs);
+					detail::raise(sos::bad_alloc<store_type>());
+				}
+				store.count(detail::stat::yields);
+				std::this_thread::yield();
+				handles = try_create_n(count, factory);
+			}
+			return handles;
+		}
+		// Like create_n, but returns an empty vector if there aren't count free slots
+		template<class Factory>
+		[[nodiscard]] std::vector<handle_type> try_create_n(idx_t count, Factory&& factory) {
+			assert(count >= 0);
+			std::vector<handle_type> handles;
+			handles.reserve(static_cast<std::size_t>(count));
+			const auto sink = [&](slot_type& slot) { handles.push_back(detail::handle_access::make<handle_type>(slot)); };
+			if (!store.try_emplace_n(count, factory, sink) && store.flush_refs() > 0) {
+				store.try_emplace_n(count, factory, sink);
+			}
+			return handles;
+		}
+
+		/*
+		 * Like create, but if the store is full, the caller sleeps until another thread releases an object.
+		 * Returns an empty handle if there is still no free slot at the deadline.
+		 */
+		template<class Clock, class Duration, class ... ARGS>
+		[[nodiscard]] handle_type create_wait(const std::chrono::time_point<Clock, Duration>& deadline, ARGS&& ... args) {
+			auto* slot = store.emplace_until(deadline, args...);
+			return slot ? detail::handle_access::make<handle_type>(*slot) : handle_type{};
+		}
+		template<class Rep, class Period, class ... ARGS>
+		[[nodiscard]] handle_type try_create_for(const std::chrono::duration<Rep, Period>& timeout, ARGS&& ... args) {
+			return create_wait(std::chrono::steady_clock::now() + timeout, args...);
 		}
-		idx_t live_objects_approx() noexcept {
-			return std::count_if(store.data.begin(), store.data.end(), [](const auto& s) { return !s.is_free(); });
+
+		// Both are O(1) (a sum over a few per-thread shards) and exact unless creates or releases run concurrently
+		idx_t live_objects_approx() const noexcept {
+			return store.live_count_approx();
 		}
 		idx_t remaining_capacity_approx() const noexcept
 		{
-			return std::count_if(store.data.begin(), store.data.end(), [](const auto& s) { return s.is_free(); });
+			return store.free_count_approx();
 		}
 		constexpr idx_t capacity() noexcept { return Size; }
 
+		// Id of the object (which doesn't keep it alive, like a weak handle)
+		id_type id_of(const const_handle_type& handle) noexcept
+		{
+			auto* slot = detail::handle_access::slot(handle);
+			return slot ? id_type(store.data.index_of(*slot), slot->ref_count().generation()) : id_type{};
+		}
+		// A handle to the object of id or an empty handle if that object doesn't exist any more
+		const_handle_type lock(id_type id) noexcept
+		{
+			if (!valid_index(id)) {
+				return {};
+			}
+			auto& slot = store.data[id.index()];
+			if (!slot.ref_count().try_add(id.generation(), id_type::generation_mask)) {
+				return {};
+			}
+			detail::trace(slot, trace_event::acquire);
+			return detail::handle_access::adopt<const_handle_type>(slot);
+		}
+		bool is_alive(id_type id) noexcept
+		{
+			return valid_index(id) && store.data[id.index()].ref_count().is_alive(id.generation(), id_type::generation_mask);
+		}
+
+		// Turns the handle into an id that keeps its reference (and thus the object alive) until it is passed to from_owning_id
+		id_type to_owning_id(const_handle_type&& handle) noexcept
+		{
+			const auto id = id_of(handle);
+			detail::handle_access::detach(handle);
+			return id;
+		}
+		// Takes over the reference of an id created by to_owning_id (exactly once)
+		const_handle_type from_owning_id(id_type id) noexcept
+		{
+			if (id.empty()) {
+				return {};
+			}
+			assert(valid_index(id) && store.data[id.index()].ref_count().is_alive(id.generation(), id_type::generation_mask));
+			return detail::handle_access::adopt<const_handle_type>(store.data[id.index()]);
+		}
+
+		/*
+		 * Calls fn(const T&) for every published object, i.e. every object that is only reachable through const handles.
+		 * Objects that are still being created, are held by a modifiable Handle or wait for deferred destruction are skipped.
+		 * Every object is pinned by a reference while fn runs, so it can't be destroyed meanwhile. Objects created or
+		 * released concurrently may or may not be visited.
+		 */
+		template<class F>
+		void for_each_live(F&& fn)
+		{
+			visit(0, Size, fn);
+		}
+
+		/*
+		 * Like for_each_live, but the slots are split into chunks that thread_cnt threads (including the calling one)
+		 * visit in parallel, so fn has to be thread safe. If fn throws, the remaining chunks are skipped and the first
+		 * exception is rethrown once all threads are done.
+		 */
+		template<class F>
+		void for_each_live_par(F&& fn, unsigned thread_cnt = std::thread::hardware_concurrency())
+		{
+			constexpr idx_t min_chunk = 256;
+			if (thread_cnt <= 1 || Size <= min_chunk) {
+				visit(0, Size, fn);
+				return;
+			}
+			const idx_t        chunk = std::max(min_chunk, Size / (static_cast<idx_t>(thread_cnt) * 4));
+			std::atomic<idx_t> next{ 0 };
+			std::exception_ptr error;
+			std::mutex         error_mtx;
+			auto               work = [&] {
+				for (idx_t first = next.fetch_add(chunk); first < Size; first = next.fetch_add(chunk)) {
+#if defined(SOS_NO_EXCEPTIONS)
+					visit(first, std::min(first + chunk, Size), fn);
+#else
+					try {
+						visit(first, std::min(first + chunk, Size), fn);
+					} catch (...) {
+						std::lock_guard<std::mutex> lock(error_mtx);
+						if (!error) {
+							error = std::current_exception();
+						}
+						next = Size;
+					}
+#endif
+				}
+			};
+			std::vector<std::thread> helpers;
+			helpers.reserve(thread_cnt - 1);
+			for (unsigned i = 1; i < thread_cnt; ++i) {
+				helpers.emplace_back(work);
+			}
+			work();
+			for (auto& t : helpers) {
+				t.join();
+			}
+			if (error) {
+				std::rethrow_exception(error);
+			}
+		}
+
+		// Const handles to all published objects (see for_each_live)
+		std::vector<const_handle_type> snapshot()
+		{
+			std::vector<const_handle_type> handles;
+			handles.reserve(static_cast<std::size_t>(live_objects_approx()));
+			for (idx_t i = 0; i < Size; ++i) {
+				if (auto handle = try_pin(store.data[i]); !handle.empty()) {
+					handles.push_back(std::move(handle));
+				}
+			}
+			return handles;
+		}
+
+		// Destroys the objects waiting for deferred reclamation and returns their number (see sos::reclaim::deferred)
+		idx_t collect() noexcept { return store.collect(); }
+		// Retired objects still count as live
+		idx_t retired_objects_approx() const noexcept { return store.retired_count_approx(); }
+		/*
+		 * Hands back the spare references that any thread caches for objects of this store (see sos::refcount::biased),
+		 * so objects only held by spares of idle threads get destroyed. Returns the number of handed back references.
+		 */
+		std::size_t flush_refs() noexcept { return store.flush_refs(); }
+
+		// Sums up the counters of all threads (only with the sos::stats::counters policy, see sos/stats.h for serialization)
+		store_stats stats() const noexcept { return store.stats(); }
+
+#if defined(SOS_ENABLE_TRACE)
+		/*
+		 * Reports all create/acquire/release/lock/unlock events of this store to sink (usually a sos::TraceRecorder)
+		 * until stop_trace(). Events of objects that already exist are recorded too, so a replay has to skip those
+		 * it can't match. The sink has to outlive all handle activity while it is attached.
+		 */
+		void start_trace(detail::TraceSink& sink) noexcept
+		{
+			sink.record(trace_event::attach, static_cast<std::uint32_t>(std::min<idx_t>(Size, std::numeric_limits<std::uint32_t>::max())));
+			store.set_tracer(&sink);
+		}
+		void stop_trace() noexcept { store.set_tracer(nullptr); }
+#endif
+
 	private:
-		detail::Store < detail::Slot<T>, Size > store;
+		store_type store;
+
+		static bool valid_index(id_type id) noexcept { return 0 <= id.index() && id.index() < Size; }
+
+		static const_handle_type try_pin(slot_type& slot) noexcept
+		{
+			if (!slot.ref_count().try_pin()) {
+				return {};
+			}
+			detail::trace(slot, trace_event::acquire);
+			return detail::handle_access::adopt<const_handle_type>(slot);
+		}
+
+		template<class F>
+		void visit(idx_t first, idx_t last, F& fn)
+		{
+			for (idx_t i = first; i < last; ++i) {
+				if (const auto pinned = try_pin(store.data[i]); !pinned.empty()) {
+					fn(*pinned);
+				}
+			}
+		}
 	};
 }}
 
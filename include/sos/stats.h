@@ -0,0 +1,62 @@
+#ifndef MGB_SHARED_OBJECT_STORE_HEADER_STATS_H
+#define MGB_SHARED_OBJECT_STORE_HEADER_STATS_H
+
+#include "sos.h"
+
+#include <sstream>
+#include <string>
+
+namespace mgb { namespace sos {
+
+	namespace detail {
+		// calls f(name, help, type, value) for every field of stats
+		template<class F>
+		void for_each_stat(const store_stats& stats, F&& f)
+		{
+			f("creates_total", "Objects created", "counter", static_cast<long long>(stats.creates));
+			f("create_failures_total", "Create attempts that found no free slot", "counter", static_cast<long long>(stats.create_failures));
+			f("releases_total", "Slots handed back to the store", "counter", static_cast<long long>(stats.releases));
+			f("cas_retries_total", "Failed CAS while claiming a free slot", "counter", static_cast<long long>(stats.cas_retries));
+			f("scan_steps_total", "Bitmap leaves or foreign magazines searched for a free slot", "counter", static_cast<long long>(stats.scan_steps));
+			f("yields_total", "Times create yielded because the store was full", "counter", static_cast<long long>(stats.yields));
+			f("waits_total", "Times create_wait went to sleep", "counter", static_cast<long long>(stats.waits));
+			f("bad_allocs_total", "sos::bad_alloc errors raised", "counter", static_cast<long long>(stats.bad_allocs));
+			f("collected_total", "Objects destroyed by collect()", "counter", static_cast<long long>(stats.collected));
+			f("live_objects", "Claimed slots", "gauge", static_cast<long long>(stats.live));
+			f("live_objects_high_water", "Maximum number of claimed slots", "gauge", static_cast<long long>(stats.live_high_water));
+			f("capacity", "Number of slots", "gauge", static_cast<long long>(stats.capacity));
+		}
+	}
+
+	/*
+	 * Prometheus text exposition of stats. Every metric is called <prefix>_<name> and gets labels (e.g. store="sessions")
+	 * attached, if they are not empty.
+	 */
+	inline std::string to_prometheus(const store_stats& stats, const std::string& prefix = "sos", const std::string& labels = "")
+	{
+		std::ostringstream out;
+		const auto         label_set = labels.empty() ? std::string() : "{" + labels + "}";
+		detail::for_each_stat(stats, [&](const char* name, const char* help, const char* type, long long value) {
+			out << "# HELP " << prefix << '_' << name << ' ' << help << '\n';
+			out << "# TYPE " << prefix << '_' << name << ' ' << type << '\n';
+			out << prefix << '_' << name << label_set << ' ' << value << '\n';
+		});
+		return out.str();
+	}
+
+	// stats as a flat JSON object (the keys are the prometheus names without prefix)
+	inline std::string to_json(const store_stats& stats)
+	{
+		std::ostringstream out;
+		const char*        sep = "";
+		out << '{';
+		detail::for_each_stat(stats, [&](const char* name, const char*, const char*, long long value) {
+			out << sep << '"' << name << "\":" << value;
+			sep = ",";
+		});
+		out << '}';
+		return out.str();
+	}
+}}
+
+#endif // !MGB_SHARED_OBJECT_STORE_HEADER_STATS_H
@@ -0,0 +1,233 @@
+#ifndef MGB_SHARED_OBJECT_STORE_HEADER_TRACE_H
+#define MGB_SHARED_OBJECT_STORE_HEADER_TRACE_H
+
+#include "sos.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mgb { namespace sos {
+
+	/*
+	 * One event of a trace file.
+	 * A trace file is a header (the magic "SOSTRACE", the format version and sizeof(TraceRecord), each as native
+	 * endian uint32 after the magic) followed by the records. Records are grouped by thread, read_trace() sorts them by time.
+	 */
+	struct TraceRecord {
+		std::uint64_t time_ns;  // since the recorder was created
+		std::uint32_t slot;     // slot index (the capacity of the store for trace_event::attach)
+		std::uint16_t thread;   // dense id of the recording thread (saturates at 65535)
+		trace_event   event;
+		std::uint8_t  reserved;
+	};
+	static_assert(sizeof(TraceRecord) == 16, "Trace records are written as they are");
+
+	namespace detail {
+		constexpr char          trace_magic[8] = { 'S', 'O', 'S', 'T', 'R', 'A', 'C', 'E' };
+		constexpr std::uint32_t trace_version  = 1;
+	}
+
+	/*
+	 * Writes the events of a store (see SharedObjectStore::start_trace, requires SOS_ENABLE_TRACE) into a binary trace file.
+	 * Every thread appends to its own buffer, which is only written to the file once it is full, on flush() and when
+	 * the recorder is destroyed. Has to outlive the tracing of all stores that use it.
+	 * Trace one store per recorder: The records don't tell the stores apart.
+	 */
+	class TraceRecorder final : public detail::TraceSink {
+		static constexpr std::size_t buffer_size = 4096;
+
+		struct ThreadBuffer {
+			std::atomic_flag           busy = ATOMIC_FLAG_INIT;
+			std::thread::id            owner;
+			std::uint16_t              thread = 0;
+			std::size_t                size   = 0;
+			std::atomic<ThreadBuffer*> next{ nullptr };
+			TraceRecord                records[buffer_size];
+		};
+
+	public:
+		explicit TraceRecorder(const std::string& path)
+			: file(std::fopen(path.c_str(), "wb"))
+		{
+			if (file == nullptr) {
+				detail::raise(std::runtime_error("Could not open trace file " + path));
+			}
+			const std::uint32_t header[2] = { detail::trace_version, sizeof(TraceRecord) };
+			if (std::fwrite(detail::trace_magic, sizeof(detail::trace_magic), 1, file) != 1 || std::fwrite(header, sizeof(header), 1, file) != 1) {
+				failed = true;
+			}
+		}
+		TraceRecorder(const TraceRecorder&) = delete;
+		TraceRecorder& operator=(const TraceRecorder&) = delete;
+		~TraceRecorder()
+		{
+			flush();
+			std::fclose(file);
+			for (auto* b = buffers.load(); b != nullptr;) {
+				delete std::exchange(b, b->next.load());
+			}
+		}
+
+		void record(trace_event event, std::uint32_t slot) noexcept override
+		{
+			auto* const buffer = local_buffer();
+			if (buffer == nullptr) {
+				dropped_cnt.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			lock(*buffer);
+			buffer->records[buffer->size++] = { now(), slot, buffer->thread, event, 0 };
+			if (buffer->size == buffer_size) {
+				write(*buffer);
+			}
+			buffer->busy.clear(std::memory_order_release);
+		}
+
+		// writes the buffered events of all threads to the file
+		void flush() noexcept
+		{
+			for (auto* b = buffers.load(std::memory_order_acquire); b != nullptr; b = b->next.load(std::memory_order_acquire)) {
+				lock(*b);
+				write(*b);
+				b->busy.clear(std::memory_order_release);
+			}
+			std::lock_guard<std::mutex> guard(mtx);
+			std::fflush(file);
+		}
+
+		// number of events written to the file so far
+		std::uint64_t written() const noexcept { return written_cnt.load(std::memory_order_relaxed); }
+		// number of events lost, because no buffer could be allocated for a thread
+		std::uint64_t dropped() const noexcept { return dropped_cnt.load(std::memory_order_relaxed); }
+		// false if writing to the file failed
+		bool good() const noexcept { return !failed.load(std::memory_order_relaxed); }
+
+	private:
+		std::FILE*                                  file;
+		const std::uint64_t                         serial = next_serial();
+		const std::chrono::steady_clock::time_point start  = std::chrono::steady_clock::now();
+		std::mutex                                  mtx;
+		std::atomic<ThreadBuffer*>                  buffers{ nullptr };
+		std::uint32_t                               thread_cnt = 0;
+		std::atomic<std::uint64_t>                  written_cnt{ 0 };
+		std::atomic<std::uint64_t>                  dropped_cnt{ 0 };
+		std::atomic_bool                            failed{ false };
+
+		static std::uint64_t next_serial() noexcept
+		{
+			static std::atomic<std::uint64_t> cnt{ 0 };
+			return ++cnt;
+		}
+
+		std::uint64_t now() const noexcept
+		{
+			return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+		}
+
+		static void lock(ThreadBuffer& buffer) noexcept
+		{
+			while (buffer.busy.test_and_set(std::memory_order_acquire)) {
+				std::this_thread::yield();
+			}
+		}
+
+		/*
+		 * The buffer of the calling thread (nullptr if it couldn't be allocated).
+		 * Every thread remembers its buffers of the last few recorders. If that misses (e.g. a thread alternates between
+		 * more traced stores), the buffer is looked up in the recorder's list, so a thread never gets a second one.
+		 * (A thread that reuses the id of an exited one also takes over its buffer and dense id.)
+		 */
+		ThreadBuffer* local_buffer() noexcept
+		{
+			// identifies the recorder by its serial, because another one may reuse the address of a destroyed one
+			struct Local {
+				std::uint64_t serial = 0;
+				ThreadBuffer* buffer = nullptr;
+			};
+			static thread_local std::array<Local, 4> local{};
+			static thread_local std::size_t          victim = 0;
+			for (const auto& l : local) {
+				if (l.serial == serial) {
+					return l.buffer;
+				}
+			}
+			auto& entry  = local[victim++ % local.size()];
+			entry.serial = serial;
+			entry.buffer = find_or_add_buffer();
+			return entry.buffer;
+		}
+
+		ThreadBuffer* find_or_add_buffer() noexcept
+		{
+			const auto self = std::this_thread::get_id();
+			for (auto* b = buffers.load(std::memory_order_acquire); b != nullptr; b = b->next.load(std::memory_order_acquire)) {
+				if (b->owner == self) {
+					return b;
+				}
+			}
+			auto* const buffer = new (std::nothrow) ThreadBuffer;
+			if (buffer != nullptr) {
+				std::lock_guard<std::mutex> guard(mtx);
+				buffer->owner = self;
+				// ids saturate, threads beyond the 65535th share the last one
+				buffer->thread = static_cast<std::uint16_t>(std::min<std::uint32_t>(thread_cnt++, 0xFFFF));
+				buffer->next.store(buffers.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				buffers.store(buffer, std::memory_order_release);
+			}
+			return buffer;
+		}
+
+		// the caller holds the busy flag of buffer
+		void write(ThreadBuffer& buffer) noexcept
+		{
+			if (buffer.size == 0) {
+				return;
+			}
+			std::lock_guard<std::mutex> guard(mtx);
+			if (std::fwrite(buffer.records, sizeof(TraceRecord), buffer.size, file) != buffer.size) {
+				failed = true;
+			}
+			written_cnt.fetch_add(buffer.size, std::memory_order_relaxed);
+			buffer.size = 0;
+		}
+	};
+
+	// Reads a trace file written by a TraceRecorder and returns its records sorted by time
+	inline std::vector<TraceRecord> read_trace(const std::string& path)
+	{
+		std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(std::fopen(path.c_str(), "rb"), &std::fclose);
+		if (!file) {
+			detail::raise(std::runtime_error("Could not open trace file " + path));
+		}
+		char          magic[sizeof(detail::trace_magic)];
+		std::uint32_t header[2];
+		if (std::fread(magic, sizeof(magic), 1, file.get()) != 1 || std::fread(header, sizeof(header), 1, file.get()) != 1
+			|| std::memcmp(magic, detail::trace_magic, sizeof(magic)) != 0) {
+			detail::raise(std::runtime_error(path + " is not a trace file"));
+		}
+		if (header[0] != detail::trace_version || header[1] != sizeof(TraceRecord)) {
+			detail::raise(std::runtime_error(path + " has an unsupported trace format"));
+		}
+
+		std::vector<TraceRecord> records;
+		TraceRecord              chunk[1024];
+		while (const auto cnt = std::fread(chunk, sizeof(TraceRecord), 1024, file.get())) {
+			records.insert(records.end(), chunk, chunk + cnt);
+		}
+		std::stable_sort(records.begin(), records.end(), [](const TraceRecord& l, const TraceRecord& r) { return l.time_ns < r.time_ns; });
+		return records;
+	}
+}}
+
+#endif // !MGB_SHARED_OBJECT_STORE_HEADER_TRACE_H
@@ -0,0 +1,615 @@
+#ifndef MGB_SHARED_OBJECT_STORE_HEADER_VIRTUAL_STORE_H
+#define MGB_SHARED_OBJECT_STORE_HEADER_VIRTUAL_STORE_H
+
+#include "sos.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+namespace mgb { namespace sos {
+
+	enum class page_mode {
+		normal,
+		transparent_huge, // ask the OS to back the store with huge pages where it can (Linux THP)
+		explicit_huge,    // map the store from the reserved huge page pool (MAP_HUGETLB / MEM_LARGE_PAGES)
+	};
+
+	/*
+	 * How the memory of a VirtualObjectStore gets backed.
+	 * With huge pages every segment gets rounded up to a multiple of the huge page size, so SegmentSize should be chosen
+	 * accordingly. If explicit huge pages aren't available, the store falls back to normal pages (see backing_page_size()).
+	 * Locked memory is never decommitted.
+	 */
+	struct memory_options {
+		page_mode pages    = page_mode::normal;
+		bool      prefault = false; // commit and touch the whole capacity at construction (see also prefault())
+		bool      lock     = false; // mlock committed segments
+		int       node     = -1;    // NUMA node the memory gets bound to (-1: no binding)
+	};
+
+	namespace detail { namespace vm {
+
+		inline std::size_t page_size() noexcept
+		{
+#if defined(_WIN32)
+			SYSTEM_INFO info;
+			GetSystemInfo(&info);
+			return info.dwPageSize;
+#else
+			return static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#endif
+		}
+
+		// Default huge page size of the system (or 0 if there is none)
+		inline std::size_t huge_page_size() noexcept
+		{
+#if defined(_WIN32)
+			return GetLargePageMinimum();
+#else
+			std::ifstream meminfo("/proc/meminfo");
+			std::string   key;
+			std::size_t   kb = 0;
+			while (meminfo >> key) {
+				if (key == "Hugepagesize:" && meminfo >> kb) {
+					return kb * 1024;
+				}
+				meminfo.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+			}
+			return 0;
+#endif
+		}
+
+		inline std::size_t round_up(std::size_t bytes, std::size_t granularity) noexcept
+		{
+			return (bytes + granularity - 1) / granularity * granularity;
+		}
+
+		// Address range reserved without backing it with memory
+		struct Reservation {
+			char*       base  = nullptr;
+			std::size_t bytes = 0;
+			page_mode   mode  = page_mode::normal;
+
+			char*       mapping       = nullptr; // what has to be released (base might be aligned within it)
+			std::size_t mapping_bytes = 0;
+		};
+
+		// Reserves bytes aligned to alignment. If mode can't be provided, it falls back to normal pages
+		inline Reservation reserve(std::size_t bytes, std::size_t alignment, page_mode mode) noexcept
+		{
+			Reservation r;
+#if defined(_WIN32)
+			if (mode == page_mode::explicit_huge) {
+				// large pages can't be committed lazily on windows
+				r.mapping = static_cast<char*>(VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+				if (r.mapping) {
+					r.base = r.mapping;
+					r.bytes = r.mapping_bytes = bytes;
+					r.mode = mode;
+					return r;
+				}
+			}
+			(void)alignment; // VirtualAlloc reservations are aligned to 64KiB anyway
+			r.mapping = static_cast<char*>(VirtualAlloc(nullptr, bytes, MEM_RESERVE, PAGE_NOACCESS));
+			r.base    = r.mapping;
+			r.bytes = r.mapping_bytes = r.mapping ? bytes : 0;
+			return r;
+#else
+#if defined(MAP_HUGETLB)
+			if (mode == page_mode::explicit_huge) {
+				void* const p = mmap(nullptr, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+				if (p != MAP_FAILED) {
+					r.base = r.mapping = static_cast<char*>(p);
+					r.bytes = r.mapping_bytes = bytes;
+					r.mode = mode;
+					return r;
+				}
+			}
+#endif
+			const std::size_t total = bytes + alignment - page_size();
+			void* const       p     = mmap(nullptr, total, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+			if (p == MAP_FAILED) {
+				return r;
+			}
+			r.mapping       = static_cast<char*>(p);
+			r.mapping_bytes = total;
+			r.base          = reinterpret_cast<char*>(round_up(reinterpret_cast<std::uintptr_t>(p), alignment));
+			r.bytes         = bytes;
+#if defined(MADV_HUGEPAGE)
+			if (mode == page_mode::transparent_huge && madvise(r.base, bytes, MADV_HUGEPAGE) == 0) {
+				r.mode = mode;
+			}
+#endif
+			return r;
+#endif
+		}
+
+		inline void release(const Reservation& r) noexcept
+		{
+#if defined(_WIN32)
+			VirtualFree(r.mapping, 0, MEM_RELEASE);
+#else
+			munmap(r.mapping, r.mapping_bytes);
+#endif
+		}
+
+		// Makes a reserved range usable. Memory gets zero initialized
+		inline bool commit(const Reservation& r, void* p, std::size_t bytes) noexcept
+		{
+#if defined(_WIN32)
+			if (r.mode == page_mode::explicit_huge) {
+				return true; // committed as a whole by reserve
+			}
+			return VirtualAlloc(p, bytes, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+			(void)r;
+			return mprotect(p, bytes, PROT_READ | PROT_WRITE) == 0;
+#endif
+		}
+
+		// Hands the memory back to the OS, but keeps the address range reserved
+		inline void decommit(void* p, std::size_t bytes) noexcept
+		{
+#if defined(_WIN32)
+			VirtualFree(p, bytes, MEM_DECOMMIT);
+#else
+			madvise(p, bytes, MADV_DONTNEED);
+			mprotect(p, bytes, PROT_NONE);
+#endif
+		}
+
+		// Faults in all pages of a freshly committed (and therefore still unused) range
+		inline void populate(void* p, std::size_t bytes, std::size_t page) noexcept
+		{
+#if defined(MADV_POPULATE_WRITE)
+			if (madvise(p, bytes, MADV_POPULATE_WRITE) == 0) {
+				return;
+			}
+#endif
+			auto* const mem = static_cast<volatile char*>(p);
+			for (std::size_t offset = 0; offset < bytes; offset += page) {
+				mem[offset] = 0;
+			}
+		}
+
+		// Binds the (not yet faulted in) memory to a NUMA node. Only does something on linux
+		inline bool bind_to_node(void* p, std::size_t bytes, int node) noexcept
+		{
+#if defined(__linux__) && defined(SYS_mbind)
+			constexpr int         mpol_bind     = 2;
+			constexpr std::size_t bits_per_word = sizeof(unsigned long) * 8;
+			constexpr std::size_t max_nodes     = 1024;
+
+			assert(0 <= node && static_cast<std::size_t>(node) < max_nodes);
+			unsigned long mask[max_nodes / bits_per_word] = {};
+			mask[node / bits_per_word] |= 1ul << (node % bits_per_word);
+			return syscall(SYS_mbind, p, bytes, mpol_bind, mask, max_nodes + 1, 0) == 0;
+#else
+			(void)p, (void)bytes, (void)node;
+			return false;
+#endif
+		}
+
+		inline bool lock(void* p, std::size_t bytes) noexcept
+		{
+#if defined(_WIN32)
+			return VirtualLock(p, bytes) != 0;
+#else
+			return mlock(p, bytes) == 0;
+#endif
+		}
+
+		// Largest page size actually backing [p, p + bytes)
+		inline std::size_t backing_page_size(const Reservation& r) noexcept
+		{
+			if (r.mode == page_mode::explicit_huge) {
+				return huge_page_size();
+			}
+#if defined(__linux__)
+			if (r.mode == page_mode::transparent_huge) {
+				// sum up AnonHugePages of all mappings that overlap our range
+				std::ifstream     smaps("/proc/self/smaps");
+				std::string       line;
+				bool              inside = false;
+				const auto        first  = reinterpret_cast<std::uintptr_t>(r.base);
+				const auto        last   = first + r.bytes;
+				while (std::getline(smaps, line)) {
+					std::uintptr_t from = 0;
+					std::uintptr_t to   = 0;
+					char           dash = 0;
+					std::istringstream range(line);
+					if (line.find('-') != std::string::npos && range >> std::hex >> from >> dash >> to && dash == '-') {
+						inside = from < last && first < to;
+					} else if (inside && line.compare(0, 14, "AnonHugePages:") == 0) {
+						std::istringstream value(line.substr(14));
+						std::size_t        kb = 0;
+						if (value >> kb && kb > 0) {
+							return huge_page_size();
+						}
+					}
+				}
+			}
+#endif
+			return page_size();
+		}
+	}}
+
+	namespace detail {
+		// Bookkeeping of a VirtualObjectStore segment. Lives outside of the segment's memory, so it survives decommitting
+		struct SegmentControl {
+			enum : int { unused, initializing, active, closing };
+
+			std::atomic_int           state{ unused };
+			std::atomic<idx_t>        live{ 0 };
+			std::atomic_int           users{ 0 };
+			std::atomic<std::int64_t> idle_since{ 0 };
+
+			static std::int64_t now() noexcept
+			{
+				return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+			}
+
+			// Has to be held while allocating from the segment, so it doesn't get decommitted underneath
+			bool enter() noexcept
+			{
+				if (state.load(std::memory_order_relaxed) != active) {
+					return false;
+				}
+				users.fetch_add(1);
+				if (state.load() == active) {
+					return true;
+				}
+				users.fetch_sub(1);
+				return false;
+			}
+			void leave() noexcept { users.fetch_sub(1); }
+		};
+
+		template<class Slots, class Engine, class Reclaim>
+		class VirtualSegment final : public Store<Slots, Engine, Reclaim> {
+			using base = Store<Slots, Engine, Reclaim>;
+
+			SegmentControl& ctl;
+
+		public:
+			using slot_type = typename base::slot_type;
+
+			explicit VirtualSegment(SegmentControl& c) noexcept
+				: ctl(c)
+			{
+			}
+
+			template<class ... ARGS>
+			slot_type* try_emplace(ARGS&& ... args)
+			{
+				// count the object before it exists, so a decommitting thread never misses it
+				ctl.live.fetch_add(1);
+				auto* slot = base::try_emplace(std::forward<ARGS>(args)...);
+				if (slot == nullptr) {
+					ctl.live.fetch_sub(1);
+				}
+				return slot;
+			}
+
+			void release(slot_type& slot) noexcept override
+			{
+				// once live drops to zero, the segment may get decommitted, so don't touch any member afterwards
+				SegmentControl* const c = &ctl;
+				base::release(slot);
+				if (c->live.fetch_sub(1) == 1) {
+					c->idle_since.store(SegmentControl::now(), std::memory_order_relaxed);
+				}
+			}
+		};
+	}
+
+	template<class T, idx_t SegmentSize, class ... Policies>
+	class NumaObjectStore;
+
+	/*
+	 * Object store whose capacity is set at construction time.
+	 * The whole capacity is only reserved as address space. It is split into segments of SegmentSize slots,
+	 * which get committed (and their slots initialized) the first time they are needed.
+	 * decommit_idle() hands segments that have been completely free for a while back to the OS,
+	 * so the resident memory follows the number of live objects instead of the peak.
+	 * Takes the same policies as SharedObjectStore (which apply per segment), except for sos::stats.
+	 */
+	template<class T, idx_t SegmentSize = 1024, class ... Policies>
+	class VirtualObjectStore {
+		template<class, idx_t, class ...>
+		friend class NumaObjectStore;
+
+		using alloc_policy   = detail::select_policy_t<detail::alloc_policy, alloc::free_list, Policies...>;
+		using reclaim_policy = detail::select_policy_t<detail::reclaim_policy, reclaim::immediate, Policies...>;
+		static_assert(std::is_same<detail::select_policy_t<detail::stats_policy, stats::none, Policies...>, stats::none>::value,
+					  "sos::stats is only supported by SharedObjectStore");
+
+		using segment_type = detail::VirtualSegment<detail::slots_t<T, SegmentSize, Policies...>, typename alloc_policy::template engine<SegmentSize>, reclaim_policy>;
+
+	public:
+		using slot_type         = typename segment_type::slot_type;
+		using handle_type       = Handle<T, slot_type>;
+		using const_handle_type = ConstHandle<T, slot_type>;
+		using weak_handle_type  = WeakHandle<T, slot_type>;
+
+		// capacity gets rounded up to a multiple of SegmentSize
+		explicit VirtualObjectStore(idx_t capacity, memory_options options = {})
+			: opts(options)
+			, segment_cnt((capacity - 1) / SegmentSize + 1)
+			, segment_bytes(segment_size_in_bytes(options.pages))
+			, controls(new detail::SegmentControl[segment_cnt])
+			, memory(detail::vm::reserve(segment_cnt * segment_bytes, segment_alignment(options.pages), options.pages))
+			, region(memory.base)
+		{
+			assert(capacity > 0);
+			if (region == nullptr) {
+				detail::raise(std::bad_alloc());
+			}
+			if (opts.node >= 0) {
+				bound = detail::vm::bind_to_node(region, segment_cnt * segment_bytes, opts.node);
+			}
+			if (opts.prefault) {
+				prefault();
+			}
+		}
+		VirtualObjectStore(const VirtualObjectStore&) = delete;
+		VirtualObjectStore& operator=(const VirtualObjectStore&) = delete;
+		~VirtualObjectStore()
+		{
+			for (idx_t i = 0; i < segment_cnt; ++i) {
+				if (controls[i].state.load() != detail::SegmentControl::unused) {
+					segment(i).~segment_type();
+				}
+			}
+			detail::vm::release(memory);
+		}
+
+		template<class ... ARGS>
+		[[nodiscard]] handle_type create(ARGS&& ... args) {
+			int fail_cnt = 0;
+			auto* slot = try_emplace(args...);
+			while (slot == nullptr) {
+				std::this_thread::yield();
+				fail_cnt++;
+				if (fail_cnt > 10) {
+					detail::raise(sos::bad_alloc<VirtualObjectStore>());
+				}
+				slot = try_emplace(args...);
+			}
+			return detail::handle_access::make<handle_type>(*slot);
+		}
+
+		// Like create, but returns an empty handle instead of throwing (or retrying) if the store is full
+		template<class ... ARGS>
+		[[nodiscard]] handle_type try_create(ARGS&& ... args) {
+			auto* slot = try_emplace(args...);
+			return slot ? detail::handle_access::make<handle_type>(*slot) : handle_type{};
+		}
+
+		/*
+		 * Decommits all segments that have no live object and have been idle for at least min_idle.
+		 * Returns the number of decommitted segments. Can be called concurrently to create and release.
+		 * Does nothing if the memory is locked or backed by explicit huge pages.
+		 */
+		idx_t decommit_idle(std::chrono::nanoseconds min_idle = std::chrono::nanoseconds{ 0 })
+		{
+			if (opts.lock || memory.mode == page_mode::explicit_huge) {
+				return 0;
+			}
+			const auto threshold = detail::SegmentControl::now() - min_idle.count();
+			idx_t cnt = 0;
+			for (idx_t i = 0; i < segment_cnt; ++i) {
+				auto& ctl = controls[i];
+				if (ctl.live.load() != 0 || ctl.idle_since.load(std::memory_order_relaxed) > threshold) {
+					continue;
+				}
+				int expected = detail::SegmentControl::active;
+				if (!ctl.state.compare_exchange_strong(expected, detail::SegmentControl::closing)) {
+					continue;
+				}
+				while (ctl.users.load() != 0) {
+					std::this_thread::yield();
+				}
+				if (ctl.live.load() != 0) {
+					ctl.state.store(detail::SegmentControl::active);
+					continue;
+				}
+				segment(i).~segment_type();
+				detail::vm::decommit(region + i * segment_bytes, segment_bytes);
+				ctl.state.store(detail::SegmentControl::unused);
+				cnt++;
+			}
+			return cnt;
+		}
+
+		// Destroys the objects waiting for deferred reclamation and returns their number (see sos::reclaim::deferred)
+		idx_t collect() noexcept
+		{
+			idx_t cnt = 0;
+			for (idx_t i = 0; i < segment_cnt; ++i) {
+				auto& ctl = controls[i];
+				if (ctl.enter()) {
+					cnt += segment(i).collect();
+					ctl.leave();
+				}
+			}
+			return cnt;
+		}
+
+		// Hands back the spare references all threads cache for this store (see sos::refcount::biased) and returns their number
+		std::size_t flush_refs() noexcept
+		{
+			if constexpr (slot_type::caches_refs) {
+				return detail::RefCache::purge(region, region + segment_cnt * segment_bytes);
+			} else {
+				return 0;
+			}
+		}
+
+		idx_t live_objects_approx() const noexcept
+		{
+			idx_t cnt = 0;
+			for (idx_t i = 0; i < segment_cnt; ++i) {
+				cnt += controls[i].live.load(std::memory_order_relaxed);
+			}
+			return cnt;
+		}
+		idx_t remaining_capacity_approx() const noexcept { return capacity() - live_objects_approx(); }
+		idx_t capacity() const noexcept { return segment_cnt * SegmentSize; }
+		// number of slots that are currently backed by memory
+		idx_t committed_capacity() const noexcept
+		{
+			idx_t cnt = 0;
+			for (idx_t i = 0; i < segment_cnt; ++i) {
+				cnt += controls[i].state.load(std::memory_order_relaxed) == detail::SegmentControl::unused ? 0 : SegmentSize;
+			}
+			return cnt;
+		}
+
+		/*
+		 * Commits and faults in all segments that aren't committed yet, so later creates and dereferences don't page fault
+		 * (the objects of already committed segments might still fault in on first use with the split layout).
+		 * Locks the memory if requested by the memory options.
+		 */
+		void prefault() noexcept
+		{
+			for (idx_t i = 0; i < segment_cnt; ++i) {
+				activate(i, true);
+			}
+		}
+
+		// page size that actually backs the store (e.g. 4KiB if huge pages were requested, but couldn't be provided)
+		std::size_t backing_page_size() const noexcept { return detail::vm::backing_page_size(memory); }
+		// false if locking was requested but at least one segment couldn't be locked (e.g. due to RLIMIT_MEMLOCK)
+		bool memory_locked() const noexcept { return opts.lock && !lock_failed.load(std::memory_order_relaxed); }
+		// true if the memory could be bound to the NUMA node requested by the memory options
+		bool node_bound() const noexcept { return bound; }
+
+	private:
+		const memory_options                      opts;
+		const idx_t                               segment_cnt;
+		const std::size_t                         segment_bytes;
+		std::unique_ptr<detail::SegmentControl[]> controls;
+		const detail::vm::Reservation             memory;
+		char* const                               region;
+		std::atomic<idx_t>                        current{ 0 };
+		std::atomic_bool                          lock_failed{ false };
+		bool                                      bound = false;
+
+		static std::size_t segment_alignment(page_mode pages) noexcept
+		{
+			const auto huge = pages == page_mode::normal ? 0 : detail::vm::huge_page_size();
+			return huge ? huge : detail::vm::page_size();
+		}
+		static std::size_t segment_size_in_bytes(page_mode pages) noexcept
+		{
+			return detail::vm::round_up(sizeof(segment_type), segment_alignment(pages));
+		}
+
+		segment_type& segment(idx_t i) noexcept { return *std::launder(reinterpret_cast<segment_type*>(region + i * segment_bytes)); }
+
+		// Commits and initializes segment i, if it is unused. Returns false if it couldn't be activated
+		bool activate(idx_t i, bool populate = false) noexcept
+		{
+			auto& ctl = controls[i];
+			int expected = detail::SegmentControl::unused;
+			if (!ctl.state.compare_exchange_strong(expected, detail::SegmentControl::initializing)) {
+				return expected == detail::SegmentControl::active;
+			}
+			char* const mem = region + i * segment_bytes;
+			if (!detail::vm::commit(memory, mem, segment_bytes)) {
+				ctl.state.store(detail::SegmentControl::unused);
+				return false;
+			}
+			if (populate || opts.prefault) {
+				detail::vm::populate(mem, segment_bytes, detail::vm::page_size());
+			}
+			if (opts.lock && !detail::vm::lock(mem, segment_bytes)) {
+				lock_failed.store(true, std::memory_order_relaxed);
+			}
+			new(mem) segment_type(ctl);
+			ctl.idle_since.store(detail::SegmentControl::now(), std::memory_order_relaxed);
+			ctl.state.store(detail::SegmentControl::active);
+			return true;
+		}
+
+		template<class ... ARGS>
+		slot_type* try_committed(ARGS&& ... args)
+		{
+			const idx_t start = current.load(std::memory_order_relaxed);
+			for (idx_t n = 0; n < segment_cnt; ++n) {
+				if (auto* slot = try_emplace_in((start + n) % segment_cnt, args...)) {
+					return slot;
+				}
+			}
+			return nullptr;
+		}
+
+		template<class ... ARGS>
+		slot_type* try_emplace_in(idx_t i, ARGS&& ... args)
+		{
+			auto& ctl = controls[i];
+			if (!ctl.enter()) {
+				return nullptr;
+			}
+			// leave even if the constructor throws, or the segment could never be decommitted again
+			struct Leave {
+				detail::SegmentControl& ctl;
+				~Leave() { ctl.leave(); }
+			} leave{ ctl };
+			auto* slot = segment(i).try_emplace(args...);
+			if (slot && current.load(std::memory_order_relaxed) != i) {
+				current.store(i, std::memory_order_relaxed);
+			}
+			return slot;
+		}
+
+		/*
+		 * First tries all committed segments (starting with the last one that had space), then hands back the spare
+		 * references of idle threads and tries them again. Only then commits a new one.
+		 */
+		template<class ... ARGS>
+		slot_type* try_emplace(ARGS&& ... args)
+		{
+			if (auto* slot = try_committed(args...)) {
+				return slot;
+			}
+			if (flush_refs() > 0) {
+				if (auto* slot = try_committed(args...)) {
+					return slot;
+				}
+			}
+			for (idx_t i = 0; i < segment_cnt; ++i) {
+				if (controls[i].state.load() == detail::SegmentControl::unused && activate(i)) {
+					if (auto* slot = try_emplace_in(i, args...)) {
+						return slot;
+					}
+				}
+			}
+			return nullptr;
+		}
+	};
+}}
+
+#endif // !MGB_SHARED_OBJECT_STORE_HEADER_VIRTUAL_STORE_H
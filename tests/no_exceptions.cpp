@@ -0,0 +1,35 @@
+// Gets compiled with exceptions disabled, to make sure the library still builds in that mode
+#include <sos/growable.h>
+#include <sos/numa_store.h>
+#include <sos/sharded_store.h>
+#include <sos/sos.h>
+#include <sos/virtual_store.h>
+
+#include <cstdio>
+
+#if !defined(SOS_NO_EXCEPTIONS)
+#error "SOS_NO_EXCEPTIONS should be detected automatically"
+#endif
+
+using namespace mgb;
+
+int main()
+{
+	sos::set_failure_handler([](const char* what) noexcept { std::fputs(what, stderr); });
+
+	sos::SharedObjectStore<int, 2> store;
+	auto h1 = store.create(1);
+	auto h2 = store.try_create(2);
+	if (h2.empty() || !store.try_create(3).empty()) {
+		return 1;
+	}
+
+	sos::GrowableObjectStore<int, 4> growable;
+	sos::ShardedObjectStore<int, 4>  sharded(2);
+	sos::VirtualObjectStore<int, 64> virt(64);
+	sos::NumaObjectStore<int, 64>    numa(64, sos::numa::Topology::fake(2));
+	if (growable.try_create(1).empty() || sharded.try_create(1).empty() || virt.try_create(1).empty() || numa.try_create(1).empty()) {
+		return 1;
+	}
+	return *h1 + *h2 == 3 ? 0 : 1;
+}
@@ -0,0 +1,405 @@
+#include <sos/sos.h>
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <typeindex>
+#include <vector>
+
+using namespace mgb;
+
+TEST_CASE("full_store_throws_bad_alloc", "[allocation]")
+{
+	sos::SharedObjectStore<int, 4> store;
+	std::vector<sos::Handle<int>> handles;
+	for (int i = 0; i < 4; ++i) {
+		handles.push_back(store.create(i));
+	}
+	CHECK(store.remaining_capacity_approx() == 0);
+	CHECK_THROWS_AS(store.create(5), std::bad_alloc);
+
+	handles.pop_back();
+	CHECK_NOTHROW(handles.push_back(store.create(6)));
+	CHECK(*handles.back() == 6);
+}
+
+TEST_CASE("most_recently_freed_slot_is_reused_first", "[allocation]")
+{
+	sos::SharedObjectStore<int, 100> store;
+	std::vector<sos::Handle<int>> handles;
+	for (int i = 0; i < 90; ++i) {
+		handles.push_back(store.create(i));
+	}
+	const int* const addr = &*handles[42];
+	handles[42] = {};
+
+	auto h = store.create(1000);
+	CHECK(&*h == addr);
+}
+
+TEST_CASE("concurrent_create_and_release", "[allocation]")
+{
+	constexpr int thread_cnt = 4;
+	constexpr int iterations = 10000;
+	sos::SharedObjectStore<int, thread_cnt * 8> store;
+
+	std::atomic_bool values_ok{ true };
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_cnt; ++t) {
+		threads.emplace_back([&store, &values_ok, t] {
+			std::vector<sos::ConstHandle<int>> handles;
+			for (int i = 0; i < iterations; ++i) {
+				handles.push_back(store.create(t * iterations + i).lock());
+				if (handles.size() == 8) {
+					for (int j = 0; j < 8; ++j) {
+						if (*handles[j] != t * iterations + i - 7 + j) {
+							values_ok = false;
+						}
+					}
+					handles.clear();
+				}
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	CHECK(values_ok);
+	CHECK(store.live_objects_approx() == 0);
+	CHECK(store.remaining_capacity_approx() == store.capacity());
+}
+
+TEST_CASE("magazines_hand_out_every_slot", "[allocation][magazines]")
+{
+	sos::SharedObjectStore<int, 16, sos::alloc::magazines<8>> store;
+	{
+		// leave some free slots cached in the magazine of another thread
+		std::thread other([&store] {
+			std::vector<sos::Handle<int>> handles;
+			for (int i = 0; i < 6; ++i) {
+				handles.push_back(store.create(i));
+			}
+		});
+		other.join();
+	}
+
+	std::vector<sos::Handle<int>> handles;
+	for (int i = 0; i < 16; ++i) {
+		handles.push_back(store.create(i));
+		CHECK(*handles.back() == i);
+	}
+	CHECK(store.remaining_capacity_approx() == 0);
+	CHECK_THROWS_AS(store.create(16), std::bad_alloc);
+
+	handles.clear();
+	CHECK(store.live_objects_approx() == 0);
+}
+
+TEST_CASE("magazines_concurrent_create_and_release", "[allocation][magazines]")
+{
+	constexpr int thread_cnt = 4;
+	sos::SharedObjectStore<int, thread_cnt * 32, sos::alloc::magazines<8, 2>> store;
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_cnt; ++t) {
+		threads.emplace_back([&store] {
+			std::vector<sos::ConstHandle<int>> handles;
+			for (int i = 0; i < 10000; ++i) {
+				handles.push_back(store.create(i).lock());
+				if (handles.size() == 16) {
+					handles.clear();
+				}
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	CHECK(store.live_objects_approx() == 0);
+}
+
+TEST_CASE("bitmap_hands_out_lowest_free_slot", "[allocation][bitmap]")
+{
+	// more than 64 * 64 slots, so the summary spans multiple words
+	using Store = sos::SharedObjectStore<int, 5000, sos::alloc::bitmap>;
+	auto store  = std::make_unique<Store>();
+
+	std::vector<sos::Handle<int>> handles;
+	for (int i = 0; i < 5000; ++i) {
+		handles.push_back(store->create(i));
+	}
+	CHECK(store->remaining_capacity_approx() == 0);
+	CHECK(store->live_objects_approx() == 5000);
+	CHECK_THROWS_AS(store->create(0), std::bad_alloc);
+
+	const int* const low  = &*handles[70];
+	const int* const high = &*handles[4500];
+	handles[4500]         = {};
+	handles[70]           = {};
+	CHECK(store->remaining_capacity_approx() == 2);
+
+	auto h1 = store->create(1);
+	auto h2 = store->create(2);
+	CHECK(&*h1 == low);
+	CHECK(&*h2 == high);
+}
+
+TEST_CASE("bitmap_concurrent_create_and_release", "[allocation][bitmap]")
+{
+	constexpr int thread_cnt = 4;
+	sos::SharedObjectStore<int, thread_cnt * 40, sos::alloc::bitmap> store;
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_cnt; ++t) {
+		threads.emplace_back([&store] {
+			std::vector<sos::ConstHandle<int>> handles;
+			for (int i = 0; i < 10000; ++i) {
+				handles.push_back(store.create(i).lock());
+				if (handles.size() == 40) {
+					handles.clear();
+				}
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	CHECK(store.live_objects_approx() == 0);
+	CHECK(store.remaining_capacity_approx() == store.capacity());
+}
+
+TEST_CASE("try_create_returns_empty_handle_on_full_store", "[allocation]")
+{
+	sos::SharedObjectStore<int, 2> store;
+	auto h1 = store.try_create(1);
+	auto h2 = store.try_create(2);
+	CHECK(!h1.empty());
+	CHECK(!h2.empty());
+	CHECK(store.try_create(3).empty());
+
+	h1 = {};
+	auto h3 = store.try_create(3);
+	REQUIRE(!h3.empty());
+	CHECK(*h3 == 3);
+}
+
+namespace {
+	struct ThrowsOnNegative {
+		explicit ThrowsOnNegative(int v)
+			: value(v)
+		{
+			if (v < 0) {
+				throw std::invalid_argument("negative");
+			}
+		}
+		int value;
+	};
+}
+
+TEST_CASE("throwing_constructor_gives_the_slot_back", "[allocation]")
+{
+	SECTION("interleaved")
+	{
+		sos::SharedObjectStore<ThrowsOnNegative, 1> store;
+		CHECK_THROWS_AS(store.create(-1), std::invalid_argument);
+		CHECK_THROWS_AS(store.try_create(-1), std::invalid_argument);
+		CHECK(store.live_objects_approx() == 0);
+		auto h = store.create(1);
+		CHECK(h->value == 1);
+	}
+	SECTION("split")
+	{
+		sos::SharedObjectStore<ThrowsOnNegative, 1, sos::layout::split<>> store;
+		CHECK_THROWS_AS(store.create(-1), std::invalid_argument);
+		auto h = store.create(1);
+		CHECK(h->value == 1);
+	}
+	SECTION("bitmap")
+	{
+		sos::SharedObjectStore<ThrowsOnNegative, 1, sos::alloc::bitmap> store;
+		CHECK_THROWS_AS(store.create(-1), std::invalid_argument);
+		auto h = store.create(1);
+		CHECK(h->value == 1);
+	}
+}
+
+TEST_CASE("create_n_creates_a_batch", "[allocation][batch]")
+{
+	auto check = [](auto& store) {
+		auto handles = store.create_n(40, [](sos::idx_t i) { return static_cast<int>(i) * 2; });
+		REQUIRE(handles.size() == 40);
+		for (std::size_t i = 0; i < handles.size(); ++i) {
+			CHECK(*handles[i] == static_cast<int>(i) * 2);
+		}
+		CHECK(store.live_objects_approx() == 40);
+
+		// all or nothing
+		CHECK(store.try_create_n(25, [](sos::idx_t) { return 0; }).empty());
+		CHECK(store.live_objects_approx() == 40);
+		CHECK_THROWS_AS(store.create_n(25, [](sos::idx_t) { return 0; }), std::bad_alloc);
+
+		auto rest = store.create_n(24, [](sos::idx_t i) { return static_cast<int>(i); });
+		CHECK(rest.size() == 24);
+		CHECK(store.remaining_capacity_approx() == 0);
+
+		// create and create_n report a full store with the same exception type
+		const auto thrown_type = [](auto&& fn) -> std::type_index {
+			try {
+				fn();
+			} catch (const std::bad_alloc& e) {
+				return typeid(e);
+			}
+			return typeid(void);
+		};
+		const auto single = thrown_type([&] { (void)store.create(0); });
+		CHECK(single != std::type_index(typeid(std::bad_alloc)));
+		CHECK(single == thrown_type([&] { (void)store.create_n(1, [](sos::idx_t) { return 0; }); }));
+		handles.clear();
+		rest.clear();
+		CHECK(store.live_objects_approx() == 0);
+	};
+	SECTION("free_list")
+	{
+		sos::SharedObjectStore<int, 64> store;
+		check(store);
+	}
+	SECTION("magazines")
+	{
+		sos::SharedObjectStore<int, 64, sos::alloc::magazines<8, 4>> store;
+		check(store);
+	}
+	SECTION("bitmap")
+	{
+		sos::SharedObjectStore<int, 64, sos::alloc::bitmap> store;
+		check(store);
+	}
+}
+
+TEST_CASE("bitmap_create_n_claims_adjacent_slots", "[allocation][batch][bitmap]")
+{
+	sos::SharedObjectStore<int, 256, sos::alloc::bitmap> store;
+	auto first = store.create(0);
+	auto batch = store.create_n(100, [](sos::idx_t i) { return static_cast<int>(i); });
+	for (std::size_t i = 1; i < batch.size(); ++i) {
+		CHECK(&*batch[i] > &*batch[i - 1]);
+	}
+	CHECK(&*batch.front() > &*first);
+}
+
+TEST_CASE("create_n_rolls_back_if_a_constructor_throws", "[allocation][batch]")
+{
+	sos::SharedObjectStore<ThrowsOnNegative, 8> store;
+	CHECK_THROWS_AS(store.create_n(8, [](sos::idx_t i) { return i == 5 ? -1 : static_cast<int>(i); }), std::invalid_argument);
+	CHECK(store.live_objects_approx() == 0);
+	auto handles = store.create_n(8, [](sos::idx_t i) { return static_cast<int>(i); });
+	CHECK(handles.size() == 8);
+}
+
+TEST_CASE("create_n_rolls_back_if_the_factory_throws", "[allocation][batch]")
+{
+	sos::SharedObjectStore<int, 8> store;
+	const auto factory = [](sos::idx_t i) {
+		if (i == 5) {
+			throw std::invalid_argument("no value for 5");
+		}
+		return static_cast<int>(i);
+	};
+	CHECK_THROWS_AS(store.create_n(8, factory), std::invalid_argument);
+	CHECK(store.live_objects_approx() == 0);
+
+	// every slot can be used again
+	std::vector<sos::Handle<int>> handles;
+	for (int i = 0; i < 8; ++i) {
+		handles.push_back(store.create(i));
+	}
+	CHECK(store.try_create().empty());
+}
+
+TEST_CASE("concurrent_create_n", "[allocation][batch]")
+{
+	sos::SharedObjectStore<int, 1000> store;
+	std::atomic_bool values_ok{ true };
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&, t] {
+			for (int round = 0; round < 200; ++round) {
+				auto handles = store.try_create_n(50, [&](sos::idx_t i) { return t * 1000 + static_cast<int>(i); });
+				for (std::size_t i = 0; i < handles.size(); ++i) {
+					if (*handles[i] != t * 1000 + static_cast<int>(i)) {
+						values_ok = false;
+					}
+				}
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	CHECK(values_ok);
+	CHECK(store.live_objects_approx() == 0);
+}
+
+TEST_CASE("live_count_follows_handles_across_threads", "[allocation]")
+{
+	constexpr int thread_cnt = 4;
+	constexpr int per_thread = 50;
+	sos::SharedObjectStore<int, 256> store;
+
+	// objects created on one thread and released on another still balance out
+	std::vector<std::vector<sos::Handle<int>>> handles(thread_cnt);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_cnt; ++t) {
+		threads.emplace_back([&, t] {
+			for (int i = 0; i < per_thread; ++i) {
+				handles[t].push_back(store.create(i));
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	CHECK(store.live_objects_approx() == thread_cnt * per_thread);
+	CHECK(store.remaining_capacity_approx() == 256 - thread_cnt * per_thread);
+
+	threads.clear();
+	for (int t = 0; t < thread_cnt; ++t) {
+		threads.emplace_back([&, t] { handles[(t + 1) % thread_cnt].clear(); });
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	CHECK(store.live_objects_approx() == 0);
+	CHECK(store.remaining_capacity_approx() == 256);
+
+	// a throwing constructor doesn't leave its slot counted
+	struct Throws {
+		Throws() { throw std::runtime_error("no"); }
+	};
+	sos::SharedObjectStore<Throws, 4, sos::alloc::bitmap> throwing;
+	CHECK_THROWS(throwing.create());
+	CHECK(throwing.live_objects_approx() == 0);
+}
+
+TEST_CASE("failed_batches_dont_count_as_live", "[allocation][batch]")
+{
+	sos::SharedObjectStore<int, 16> store;
+	auto handles = store.create_n(5, [](sos::idx_t i) { return static_cast<int>(i); });
+
+	// a batch that doesn't fit is rolled back without ever showing up in the live count
+	std::atomic<bool> done{false};
+	std::thread       batcher([&] {
+		for (int i = 0; i < 20000; ++i) {
+			(void)store.try_create_n(12, [](sos::idx_t) { return 0; });
+		}
+		done = true;
+	});
+	bool counts_ok = true;
+	while (!done) {
+		counts_ok = counts_ok && store.live_objects_approx() == 5 && store.remaining_capacity_approx() == 11;
+	}
+	batcher.join();
+	CHECK(counts_ok);
+}
@@ -0,0 +1,265 @@
+#include <sos/growable.h>
+#include <sos/sharded_store.h>
+#include <sos/sos.h>
+#include <sos/virtual_store.h>
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace mgb;
+
+namespace {
+	std::atomic_int alive{ 0 };
+
+	struct Counted {
+		int value;
+		explicit Counted(int v)
+			: value(v)
+		{
+			++alive;
+		}
+		~Counted() { --alive; }
+	};
+
+	using Store = sos::SharedObjectStore<Counted, 64, sos::refcount::biased<4>>;
+}
+
+TEST_CASE("biased_refcount_destroys_after_flush", "[biased]")
+{
+	alive = 0;
+	Store store;
+	{
+		auto handle = std::move(store.create(1)).lock();
+		std::vector<Store::const_handle_type> copies(10, handle);
+		CHECK(copies[9]->value == 1);
+	}
+	// the last references may still be cached as spares of this thread
+	sos::flush_thread_refs();
+	CHECK(alive == 0);
+	CHECK(store.live_objects_approx() == 0);
+
+	// an object that never got copied is destroyed right away
+	{
+		auto handle = store.create(2);
+	}
+	sos::flush_thread_refs();
+	CHECK(alive == 0);
+}
+
+TEST_CASE("biased_refcount_handles_cross_threads", "[biased]")
+{
+	alive = 0;
+	Store store;
+	auto hot = std::move(store.create(42)).lock();
+	std::atomic_bool values_ok{ true };
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&] {
+			std::vector<Store::const_handle_type> local;
+			for (int i = 0; i < 10000; ++i) {
+				local.push_back(hot);
+				if (local.size() > 8) {
+					local.erase(local.begin());
+				}
+				if (local.back()->value != 42) {
+					values_ok = false;
+				}
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	CHECK(values_ok);
+	// the exited threads handed their spares back, so only the main thread's reference (and spares) remain
+	hot = Store::const_handle_type{};
+	sos::flush_thread_refs();
+	CHECK(alive == 0);
+	CHECK(store.live_objects_approx() == 0);
+}
+
+TEST_CASE("biased_refcount_handle_moved_to_other_thread", "[biased]")
+{
+	alive = 0;
+	Store store;
+	auto handle = std::move(store.create(7)).lock();
+	std::vector<Store::const_handle_type> copies(20, handle);
+	handle = Store::const_handle_type{};
+
+	std::thread consumer([copies = std::move(copies)]() mutable {
+		copies.clear();
+		sos::flush_thread_refs();
+	});
+	consumer.join();
+	sos::flush_thread_refs();
+	CHECK(alive == 0);
+}
+
+TEST_CASE("biased_refcount_store_dies_with_cached_spares", "[biased]")
+{
+	alive = 0;
+	{
+		Store store;
+		auto handle = std::move(store.create(1)).lock();
+		auto copy   = handle;
+		(void)copy;
+	}
+	CHECK(alive == 0);
+	// nothing in this thread's cache may refer to the dead store any more
+	sos::flush_thread_refs();
+}
+
+TEST_CASE("biased_refcount_keeps_unique_exact", "[biased]")
+{
+	alive = 0;
+	Store store;
+	auto handle = store.create(1);
+	CHECK(handle.unique());
+	auto shared = std::move(handle).lock();
+	CHECK(shared.unique());
+	{
+		// the copy leaves spares in the cache of this thread, which don't count
+		auto copy = shared;
+		CHECK(!shared.unique());
+	}
+	CHECK(shared.unique());
+	auto mut = std::move(shared).turn_into_modifiable_handle();
+	CHECK(mut.unique());
+	mut = Store::handle_type{};
+	// dropping the modifiable handle destroys the object right away
+	CHECK(alive == 0);
+}
+
+namespace {
+	// Copies a handle whenever asked to and stays alive (keeping its spares) until it is destroyed
+	class IdleCopier {
+	public:
+		template<class H>
+		void copy(const H& handle)
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			task = [&handle] { auto copy = handle; };
+			cv.notify_all();
+			cv.wait(lock, [&] { return !task; });
+		}
+		~IdleCopier()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				finish = true;
+			}
+			cv.notify_all();
+			worker.join();
+		}
+
+	private:
+		std::mutex              mtx;
+		std::condition_variable cv;
+		std::function<void()>   task;
+		bool                    finish = false;
+		std::thread             worker{ [this] {
+			std::unique_lock<std::mutex> lock(mtx);
+			for (;;) {
+				cv.wait(lock, [&] { return finish || task; });
+				if (finish) {
+					return;
+				}
+				task();
+				task = nullptr;
+				cv.notify_all();
+			}
+		} };
+	};
+}
+
+TEST_CASE("biased_refcount_store_reclaims_spares_of_idle_threads", "[biased]")
+{
+	alive = 0;
+	sos::SharedObjectStore<Counted, 1, sos::refcount::biased<4>> store;
+	IdleCopier other;
+
+	auto handle = std::move(store.create(1)).lock();
+	other.copy(handle);
+	// spares of other threads count as references
+	CHECK(!handle.unique());
+	handle = decltype(handle){};
+	sos::flush_thread_refs();
+	CHECK(alive == 1);
+	CHECK(store.flush_refs() > 0);
+	CHECK(alive == 0);
+
+	// try_upgrade doesn't depend on the other thread handing its spares back
+	handle = std::move(store.create(2)).lock();
+	other.copy(handle);
+	auto mut = std::move(handle).try_upgrade();
+	REQUIRE(!mut.empty());
+	handle = std::move(mut).lock();
+
+	// neither does create in a store that is only full because of spares
+	other.copy(handle);
+	handle = decltype(handle){};
+	auto replacement = store.create(3);
+	CHECK(replacement->value == 3);
+	CHECK(alive == 1);
+}
+
+namespace {
+	// Fills the store with objects that are only kept alive by the spare references this thread caches
+	template<class S>
+	void fill_with_spares(S& store, int cnt)
+	{
+		for (int i = 0; i < cnt; ++i) {
+			auto handle = std::move(store.create(i)).lock();
+			auto copy   = handle;
+		}
+	}
+}
+
+TEST_CASE("biased_refcount_full_stores_reclaim_spares", "[biased]")
+{
+	alive = 0;
+	SECTION("shared")
+	{
+		sos::SharedObjectStore<Counted, 4, sos::refcount::biased<4>> store;
+		fill_with_spares(store, 4);
+		CHECK(!store.try_create(5).empty());
+
+		fill_with_spares(store, 3);
+		CHECK(store.try_create_n(4, [](sos::idx_t i) { return static_cast<int>(i); }).size() == 4);
+		fill_with_spares(store, 3);
+		CHECK(store.create_n(4, [](sos::idx_t i) { return static_cast<int>(i); }).size() == 4);
+	}
+	SECTION("sharded")
+	{
+		sos::ShardedObjectStore<Counted, 4, sos::refcount::biased<4>> store(2);
+		fill_with_spares(store, 8);
+		CHECK(!store.try_create(9).empty());
+		fill_with_spares(store, 7);
+		CHECK(store.create(9)->value == 9);
+	}
+	SECTION("growable")
+	{
+		sos::GrowableObjectStore<Counted, 4, sos::refcount::biased<4>> store;
+		fill_with_spares(store, 8);
+		// the spares are handed back instead of appending a segment for every object
+		CHECK(store.capacity() == 4);
+		CHECK(!store.try_create(9).empty());
+	}
+	SECTION("virtual")
+	{
+		sos::VirtualObjectStore<Counted, 4, sos::refcount::biased<4>> store(8);
+		fill_with_spares(store, 8);
+		CHECK(store.committed_capacity() == 4);
+		fill_with_spares(store, 8);
+		CHECK(store.create(9)->value == 9);
+	}
+	sos::flush_thread_refs();
+	CHECK(alive == 0);
+}
@@ -0,0 +1,71 @@
+#include <sos/sos.h>
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace mgb;
+using namespace std::chrono_literals;
+
+TEST_CASE("try_create_for_times_out_on_full_store", "[blocking]")
+{
+	sos::SharedObjectStore<int, 2> store;
+	auto h1 = store.create(1);
+	auto h2 = store.create(2);
+
+	const auto start = std::chrono::steady_clock::now();
+	auto       h3    = store.try_create_for(20ms, 3);
+	CHECK(h3.empty());
+	CHECK(std::chrono::steady_clock::now() - start >= 20ms);
+
+	h1 = {};
+	auto h4 = store.try_create_for(0ms, 4);
+	REQUIRE(!h4.empty());
+	CHECK(*h4 == 4);
+}
+
+TEST_CASE("create_wait_wakes_up_on_release", "[blocking]")
+{
+	sos::SharedObjectStore<int, 1> store;
+	auto h1 = store.create(1);
+
+	std::thread releaser([&h1] {
+		std::this_thread::sleep_for(20ms);
+		h1 = {};
+	});
+	const auto start = std::chrono::steady_clock::now();
+	auto       h2    = store.create_wait(start + 10s, 2);
+	releaser.join();
+
+	REQUIRE(!h2.empty());
+	CHECK(*h2 == 2);
+	CHECK(std::chrono::steady_clock::now() - start < 10s);
+}
+
+TEST_CASE("create_wait_under_contention", "[blocking]")
+{
+	constexpr int thread_cnt = 4;
+	constexpr int per_thread = 2000;
+	sos::SharedObjectStore<int, 2> store;
+
+	std::atomic_int created{ 0 };
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_cnt; ++t) {
+		threads.emplace_back([&] {
+			for (int i = 0; i < per_thread; ++i) {
+				auto h = store.create_wait(std::chrono::steady_clock::now() + 10s, i);
+				if (!h.empty() && *h == i) {
+					created++;
+				}
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	CHECK(created == thread_cnt * per_thread);
+	CHECK(store.live_objects_approx() == 0);
+}
@@ -25,6 +25,7 @@ TEST_CASE( "Compilation", "[sos][General]" )
 
 	auto handle = std::move( mut_handle ).lock();
 	CHECK( mut_handle.empty() );
+	CHECK( !handle.empty() );
 	[[maybe_unused]] auto i5 = static_cast<const TestStruct&>( handle );
 	[[maybe_unused]] auto i6 = *handle;
 	[[maybe_unused]] auto i7 = handle->i;
@@ -0,0 +1,127 @@
+#include <sos/growable.h>
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mgb;
+
+TEST_CASE("growable_store_adds_segments", "[growable]")
+{
+	sos::GrowableObjectStore<std::string, 8> store;
+	CHECK(store.capacity() == 8);
+	CHECK(store.max_capacity() == store.no_limit);
+
+	std::vector<sos::ConstHandle<std::string>> handles;
+	std::vector<const std::string*> addresses;
+	for (int i = 0; i < 100; ++i) {
+		handles.push_back(store.create(std::to_string(i)).lock());
+		addresses.push_back(&*handles.back());
+	}
+	CHECK(store.capacity() == 104);
+	CHECK(store.live_objects_approx() == 100);
+	CHECK(store.remaining_capacity_approx() == 4);
+
+	for (int i = 0; i < 100; ++i) {
+		CHECK(&*handles[i] == addresses[i]);
+		CHECK(*handles[i] == std::to_string(i));
+	}
+
+	handles.clear();
+	CHECK(store.live_objects_approx() == 0);
+	CHECK(store.capacity() == 104);
+}
+
+TEST_CASE("growable_store_respects_max_capacity", "[growable]")
+{
+	sos::GrowableObjectStore<int, 4> store(10);
+	CHECK(store.max_capacity() == 12);
+
+	std::vector<sos::Handle<int>> handles;
+	for (int i = 0; i < 12; ++i) {
+		handles.push_back(store.create(i));
+	}
+	CHECK(store.capacity() == 12);
+	CHECK_THROWS_AS(store.create(12), std::bad_alloc);
+
+	// freed slots in earlier segments are found again
+	handles[1] = {};
+	CHECK_NOTHROW(handles[1] = store.create(1));
+}
+
+TEST_CASE("growable_store_concurrent_growth", "[growable]")
+{
+	constexpr int thread_cnt = 4;
+	constexpr int per_thread = 1000;
+	sos::GrowableObjectStore<int, 16> store;
+
+	std::atomic_bool values_ok{ true };
+	std::atomic_int  done{ 0 };
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_cnt; ++t) {
+		threads.emplace_back([&store, &values_ok, &done, t] {
+			std::vector<sos::Handle<int>> handles;
+			for (int i = 0; i < per_thread; ++i) {
+				handles.push_back(store.create(t * per_thread + i));
+			}
+			// keep all objects alive until every thread created its share
+			done++;
+			while (done != thread_cnt) {
+				std::this_thread::yield();
+			}
+			for (int i = 0; i < per_thread; ++i) {
+				if (*handles[i] != t * per_thread + i) {
+					values_ok = false;
+				}
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	CHECK(values_ok);
+	CHECK(store.live_objects_approx() == 0);
+	CHECK(store.capacity() >= thread_cnt * per_thread);
+}
+
+TEST_CASE("growable_store_stays_bounded_under_fifo_churn", "[growable]")
+{
+	constexpr int live = 64;
+	sos::GrowableObjectStore<int, 16> store;
+
+	// releasing the oldest object frees a slot in an early segment, which has to be found before growing
+	std::deque<sos::Handle<int>> handles;
+	for (int i = 0; i < 100000; ++i) {
+		handles.push_back(store.create(i));
+		if (handles.size() > live) {
+			handles.pop_front();
+		}
+	}
+	CHECK(store.capacity() <= live + 16);
+	CHECK(store.live_objects_approx() == live);
+
+	// the same with several threads, each keeping its own window of objects
+	constexpr int thread_cnt = 4;
+	sos::GrowableObjectStore<int, 16> shared;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_cnt; ++t) {
+		threads.emplace_back([&shared] {
+			std::deque<sos::Handle<int>> window;
+			for (int i = 0; i < 20000; ++i) {
+				window.push_back(shared.create(i));
+				if (window.size() > live) {
+					window.pop_front();
+				}
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	CHECK(shared.capacity() <= 2 * thread_cnt * live);
+	CHECK(shared.live_objects_approx() == 0);
+}
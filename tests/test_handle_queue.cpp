@@ -0,0 +1,139 @@
+#include <sos/handle_queue.h>
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace mgb;
+
+TEST_CASE("handle_queue_transfers_ownership", "[queue]")
+{
+	using Store = sos::SharedObjectStore<int, 16>;
+	Store store;
+	sos::HandleQueue<Store> queue(store, 3);
+	CHECK(queue.capacity() == 4);
+	CHECK(queue.try_pop().empty());
+
+	for (int i = 0; i < 4; ++i) {
+		auto h = std::move(store.create(i)).lock();
+		CHECK(queue.try_push(std::move(h)));
+		CHECK(h.empty());
+	}
+	auto extra = std::move(store.create(4)).lock();
+	CHECK(!queue.try_push(std::move(extra)));
+	CHECK(!extra.empty());
+	CHECK(queue.size_approx() == 4);
+	CHECK(store.live_objects_approx() == 5);
+
+	for (int i = 0; i < 4; ++i) {
+		auto h = queue.try_pop();
+		REQUIRE(!h.empty());
+		CHECK(*h == i);
+		CHECK(h.unique());
+	}
+	CHECK(queue.try_pop().empty());
+	CHECK(store.live_objects_approx() == 1);
+}
+
+TEST_CASE("handle_queue_of_mutable_handles_in_batches", "[queue]")
+{
+	using Store = sos::SharedObjectStore<int, 64, sos::layout::split<>>;
+	Store store;
+	{
+		sos::HandleQueue<Store, Store::handle_type> queue(store, 8);
+		std::vector<Store::handle_type> in;
+		for (int i = 0; i < 10; ++i) {
+			in.push_back(store.create(i));
+		}
+		CHECK(queue.try_push_n(in.data(), in.size()) == 8);
+		CHECK(in[7].empty());
+		CHECK(!in[8].empty());
+
+		std::vector<Store::handle_type> out(5);
+		CHECK(queue.try_pop_n(out.data(), out.size()) == 5);
+		for (int i = 0; i < 5; ++i) {
+			*out[static_cast<std::size_t>(i)] += 100;
+			CHECK(*out[static_cast<std::size_t>(i)] == 100 + i);
+		}
+		CHECK(queue.try_push_n(in.data() + 8, 2) == 2);
+		CHECK(queue.size_approx() == 5);
+		CHECK(store.live_objects_approx() == 10);
+		out.clear();
+		CHECK(store.live_objects_approx() == 5);
+		// the remaining handles are released with the queue
+	}
+	CHECK(store.live_objects_approx() == 0);
+}
+
+TEST_CASE("handle_queue_rejects_empty_handles_and_zero_counts", "[queue]")
+{
+	using Store = sos::SharedObjectStore<int, 16>;
+	Store store;
+	sos::HandleQueue<Store> queue(store, 4);
+
+	CHECK(queue.try_push_n(nullptr, 0) == 0);
+	CHECK(queue.try_pop_n(nullptr, 0) == 0);
+	CHECK(!queue.try_push(Store::const_handle_type{}));
+	CHECK(queue.size_approx() == 0);
+
+	// a batch stops before the first empty handle
+	std::vector<Store::const_handle_type> in(3);
+	in[0] = std::move(store.create(0)).lock();
+	in[2] = std::move(store.create(2)).lock();
+	CHECK(queue.try_push_n(in.data(), in.size()) == 1);
+	CHECK(in[0].empty());
+	CHECK(!in[2].empty());
+	CHECK(queue.size_approx() == 1);
+
+	std::vector<Store::const_handle_type> out(1);
+	CHECK(queue.try_pop_n(out.data(), 0) == 0);
+	CHECK(queue.try_pop_n(out.data(), 1) == 1);
+	CHECK(*out[0] == 0);
+}
+
+TEST_CASE("handle_queue_concurrent_producers_and_consumers", "[queue]")
+{
+	using Store = sos::SharedObjectStore<int, 1024>;
+	Store store;
+	sos::HandleQueue<Store> queue(store, 64);
+
+	constexpr int per_producer = 20000;
+	constexpr int producers    = 2;
+	std::atomic<long long> sum{ 0 };
+	std::atomic_int        consumed{ 0 };
+	std::vector<std::thread> threads;
+	for (int p = 0; p < producers; ++p) {
+		threads.emplace_back([&] {
+			Store::const_handle_type batch[4];
+			for (int i = 0; i < per_producer; i += 4) {
+				for (int k = 0; k < 4; ++k) {
+					batch[k] = std::move(store.create(i + k)).lock();
+				}
+				std::size_t pushed = 0;
+				while (pushed < 4) {
+					pushed += queue.try_push_n(batch + pushed, 4 - pushed);
+				}
+			}
+		});
+	}
+	for (int c = 0; c < 2; ++c) {
+		threads.emplace_back([&] {
+			Store::const_handle_type batch[3];
+			while (consumed < producers * per_producer) {
+				const auto n = queue.try_pop_n(batch, 3);
+				for (std::size_t k = 0; k < n; ++k) {
+					sum += *batch[k];
+					batch[k] = Store::const_handle_type{};
+				}
+				consumed += static_cast<int>(n);
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	CHECK(sum == static_cast<long long>(producers) * per_producer * (per_producer - 1) / 2);
+	CHECK(store.live_objects_approx() == 0);
+}
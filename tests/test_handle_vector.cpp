@@ -0,0 +1,103 @@
+#include <sos/handle_vector.h>
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace mgb;
+
+TEST_CASE("handle_vector_keeps_objects_alive", "[handle_vector]")
+{
+	using Store = sos::SharedObjectStore<int, 64>;
+	Store store;
+	sos::HandleVector<Store> vec(store);
+
+	for (int i = 0; i < 10; ++i) {
+		vec.push_back(store.create(i));
+	}
+	auto shared = std::move(store.create(42)).lock();
+	vec.push_back(shared);
+	vec.push_back(shared);
+	REQUIRE(vec.size() == 12);
+	CHECK(vec[3] == 3);
+	CHECK(vec[11] == 42);
+	CHECK(store.live_objects_approx() == 11);
+
+	auto h = vec.handle(0);
+	CHECK(*h == 0);
+	auto last = vec.pop_back();
+	CHECK(*last == 42);
+	CHECK(vec.size() == 11);
+
+	shared = decltype(shared){};
+	last   = decltype(last){};
+	CHECK(store.live_objects_approx() == 11);
+	vec.clear();
+	CHECK(vec.empty());
+	// only the object that is still referenced by h survives
+	CHECK(store.live_objects_approx() == 1);
+	h = decltype(h){};
+	CHECK(store.live_objects_approx() == 0);
+}
+
+TEST_CASE("handle_vector_coalesces_duplicates", "[handle_vector]")
+{
+	using Store = sos::SharedObjectStore<int, 8, sos::layout::split<>>;
+	Store store;
+	{
+		auto shared = std::move(store.create(7)).lock();
+		sos::HandleVector<Store> vec(store);
+		for (int i = 0; i < 1000; ++i) {
+			vec.push_back(shared);
+			vec.push_back(std::move(store.create(i % 3)).lock());
+			vec.pop_back();
+		}
+		sos::HandleVector<Store> moved(std::move(vec));
+		CHECK(vec.empty());
+		CHECK(moved.size() == 1000);
+		CHECK(!shared.unique());
+		moved.clear();
+		CHECK(shared.unique());
+		moved.push_back(std::move(shared));
+		CHECK(store.live_objects_approx() == 1);
+	}
+	CHECK(store.live_objects_approx() == 0);
+}
+
+TEST_CASE("handle_vectors_on_multiple_threads", "[handle_vector]")
+{
+	using Store = sos::SharedObjectStore<int, 16>;
+	Store store;
+	std::vector<Store::const_handle_type> objects;
+	for (int i = 0; i < 16; ++i) {
+		objects.push_back(std::move(store.create(i)).lock());
+	}
+	std::atomic_bool values_ok{ true };
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&] {
+			for (int round = 0; round < 100; ++round) {
+				sos::HandleVector<Store> vec(store);
+				for (int i = 0; i < 1000; ++i) {
+					vec.push_back(objects[static_cast<std::size_t>(i % 16)]);
+				}
+				for (std::size_t i = 0; i < vec.size(); ++i) {
+					if (vec[i] != static_cast<int>(i % 16)) {
+						values_ok = false;
+					}
+				}
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	CHECK(values_ok);
+	for (auto& o : objects) {
+		CHECK(o.unique());
+	}
+	objects.clear();
+	CHECK(store.live_objects_approx() == 0);
+}
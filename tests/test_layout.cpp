@@ -0,0 +1,49 @@
+#include <sos/sos.h>
+
+#include <catch2/catch.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace mgb;
+
+TEST_CASE("split_layout_packs_objects_densely", "[layout]")
+{
+	using Store = sos::SharedObjectStore<int, 64, sos::layout::split<>>;
+	auto store  = std::make_unique<Store>();
+
+	std::vector<Store::handle_type> handles;
+	for (int i = 0; i < 64; ++i) {
+		handles.push_back(store->create(i));
+	}
+	for (int i = 1; i < 64; ++i) {
+		CHECK(&*handles[i] - &*handles[i - 1] == 1);
+	}
+	CHECK(store->remaining_capacity_approx() == 0);
+}
+
+TEST_CASE("split_layout_refcounting", "[layout]")
+{
+	sos::SharedObjectStore<std::string, 4, sos::layout::split<4>, sos::alloc::bitmap> store;
+	{
+		auto h1 = store.create("Hello1").lock();
+		auto h2 = h1;
+		CHECK(*h2 == "Hello1");
+		CHECK(store.live_objects_approx() == 1);
+
+		auto h3 = store.create("Hello3");
+		CHECK(h3.unique());
+		*h3 += "!";
+		decltype(store)::const_handle_type h4 = std::move(h3).lock();
+		CHECK(*h4 == "Hello3!");
+		CHECK(store.live_objects_approx() == 2);
+
+		h1 = h4;
+		CHECK(*h2 == "Hello1");
+		h2 = decltype(h2){};
+		CHECK(store.live_objects_approx() == 1);
+	}
+	CHECK(store.live_objects_approx() == 0);
+}
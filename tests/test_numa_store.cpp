@@ -0,0 +1,62 @@
+#include <sos/numa_store.h>
+
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace mgb;
+
+TEST_CASE("numa_topology", "[numa]")
+{
+	const auto fake = sos::numa::Topology::fake(3, 8);
+	CHECK(fake.node_cnt() == 3);
+	CHECK(fake.is_fake());
+	CHECK(fake.node_of_cpu(4) == 1);
+	CHECK(fake.node_of_cpu(100) == 0);
+	CHECK(fake.os_node(2) == -1);
+
+	const auto real = sos::numa::Topology::detect();
+	CHECK(real.node_cnt() >= 1);
+	CHECK(real.current_node() < real.node_cnt());
+}
+
+TEST_CASE("numa_store_prefers_local_node", "[numa]")
+{
+	// every cpu belongs to node 1
+	sos::numa::Topology topology(std::vector<int>(1024, 1));
+	sos::NumaObjectStore<std::string, 16> store(32, topology);
+	CHECK(store.node_cnt() == 2);
+	CHECK(store.capacity() == 64);
+
+	std::vector<sos::Handle<std::string>> handles;
+	for (int i = 0; i < 32; ++i) {
+		handles.push_back(store.create(std::to_string(i)));
+	}
+	CHECK(store.live_objects_approx(0) == 0);
+	CHECK(store.live_objects_approx(1) == 32);
+
+	// falls back to the remote node once the local one is exhausted
+	for (int i = 32; i < 64; ++i) {
+		handles.push_back(store.create(std::to_string(i)));
+	}
+	CHECK(store.live_objects_approx(0) == 32);
+	CHECK_THROWS_AS(store.create("full"), std::bad_alloc);
+
+	handles.erase(handles.begin(), handles.begin() + 10);
+	auto h = store.create_on(0, "remote");
+	CHECK(*h == "remote");
+	CHECK(store.live_objects_approx(1) == 23);
+	CHECK(store.live_objects_approx() == 55);
+}
+
+TEST_CASE("numa_store_on_detected_topology", "[numa]")
+{
+	sos::NumaObjectStore<int> store(4096);
+	auto h = store.create(42).lock();
+	CHECK(*h == 42);
+	CHECK(store.live_objects_approx() == 1);
+	if (!store.get_topology().is_fake()) {
+		CHECK(store.partition(0).node_bound());
+	}
+}
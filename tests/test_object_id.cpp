@@ -0,0 +1,69 @@
+#include <sos/sos.h>
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+using namespace mgb;
+
+static_assert(sizeof(sos::ObjectId<1000>) == 2, "Small stores use 16 bit ids");
+static_assert(sizeof(sos::ObjectId<1024>) == 4, "");
+static_assert(sizeof(sos::ObjectId<1 << 20>) == 4, "");
+static_assert(sos::ObjectId<1000>::generation_bits == 6, "");
+static_assert(std::atomic<sos::ObjectId<1 << 20>>::is_always_lock_free, "Ids fit into lock-free atomics");
+
+TEST_CASE("object_id_resolves_to_its_object", "[id]")
+{
+	sos::SharedObjectStore<std::string, 100> store;
+	auto handle = std::move(store.create("hello")).lock();
+	const auto id = store.id_of(handle);
+	CHECK(!id.empty());
+	CHECK(store.is_alive(id));
+	CHECK(store.id_of(decltype(handle){}).empty());
+
+	auto resolved = store.lock(id);
+	REQUIRE(!resolved.empty());
+	CHECK(&*resolved == &*handle);
+
+	// ids round trip through their raw value
+	const auto copy = decltype(id)::from_raw(id.raw());
+	CHECK(copy == id);
+	CHECK(*store.lock(copy) == "hello");
+
+	resolved = decltype(resolved){};
+	handle   = decltype(handle){};
+	CHECK(!store.is_alive(id));
+	CHECK(store.lock(id).empty());
+	CHECK(store.lock(decltype(id){}).empty());
+}
+
+TEST_CASE("object_id_detects_reused_slot", "[id]")
+{
+	sos::SharedObjectStore<int, 1, sos::layout::split<>> store;
+	decltype(store)::id_type old_id;
+	{
+		auto h = std::move(store.create(1)).lock();
+		old_id = store.id_of(h);
+	}
+	auto h = std::move(store.create(2)).lock();
+	const auto new_id = store.id_of(h);
+	CHECK(new_id != old_id);
+	CHECK(store.lock(old_id).empty());
+	CHECK(*store.lock(new_id) == 2);
+}
+
+TEST_CASE("owning_object_id_keeps_object_alive", "[id]")
+{
+	sos::SharedObjectStore<int, 4> store;
+	const auto id = store.to_owning_id(std::move(store.create(7)).lock());
+	CHECK(store.live_objects_approx() == 1);
+	CHECK(*store.lock(id) == 7);
+
+	auto handle = store.from_owning_id(id);
+	CHECK(handle.unique());
+	handle = decltype(handle){};
+	CHECK(store.live_objects_approx() == 0);
+}
@@ -0,0 +1,150 @@
+#include <sos/growable.h>
+#include <sos/reclaimer.h>
+#include <sos/sharded_store.h>
+#include <sos/virtual_store.h>
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace mgb;
+
+namespace {
+	std::atomic<std::thread::id> last_destroyer;
+	std::atomic_int              destroyed{ 0 };
+
+	struct Tracked {
+		int value = 0;
+		explicit Tracked(int v)
+			: value(v)
+		{
+		}
+		~Tracked()
+		{
+			last_destroyer = std::this_thread::get_id();
+			++destroyed;
+		}
+	};
+}
+
+TEST_CASE("deferred_reclamation_destroys_on_collect", "[reclaim]")
+{
+	destroyed = 0;
+	sos::SharedObjectStore<Tracked, 16, sos::reclaim::deferred<>> store;
+	{
+		auto h1 = store.create(1);
+		auto h2 = std::move(store.create(2)).lock();
+		auto h3 = h2;
+	}
+	CHECK(destroyed == 0);
+	CHECK(store.retired_objects_approx() == 2);
+	CHECK(store.live_objects_approx() == 2);
+
+	CHECK(store.collect() == 2);
+	CHECK(destroyed == 2);
+	CHECK(store.retired_objects_approx() == 0);
+	CHECK(store.live_objects_approx() == 0);
+	CHECK(store.collect() == 0);
+}
+
+TEST_CASE("deferred_reclamation_does_not_starve_the_store", "[reclaim]")
+{
+	destroyed = 0;
+	SECTION("full store collects on create")
+	{
+		sos::SharedObjectStore<Tracked, 4, sos::reclaim::deferred<>, sos::alloc::bitmap> store;
+		for (int i = 0; i < 20; ++i) {
+			auto h = store.create(i);
+			CHECK(h->value == i);
+		}
+		CHECK(destroyed == 16);
+		auto batch = store.create_n(4, [](sos::idx_t i) { return static_cast<int>(i); });
+		CHECK(batch.size() == 4);
+		CHECK(destroyed == 20);
+	}
+	SECTION("backlog limit")
+	{
+		sos::SharedObjectStore<Tracked, 64, sos::reclaim::deferred<8>> store;
+		for (int i = 0; i < 9; ++i) {
+			(void)store.create(i);
+		}
+		CHECK(destroyed == 9);
+		CHECK(store.retired_objects_approx() == 0);
+	}
+	SECTION("store destructor collects")
+	{
+		{
+			sos::SharedObjectStore<Tracked, 4, sos::reclaim::deferred<>, sos::layout::split<>> store;
+			(void)store.create(1);
+			CHECK(destroyed == 0);
+		}
+		CHECK(destroyed == 1);
+	}
+}
+
+TEST_CASE("reclaimer_thread_destroys_objects", "[reclaim]")
+{
+	destroyed = 0;
+	sos::SharedObjectStore<Tracked, 1024, sos::reclaim::deferred<>> store;
+	{
+		sos::Reclaimer<decltype(store)> reclaimer(store, std::chrono::microseconds{ 100 });
+		for (int i = 0; i < 100; ++i) {
+			(void)store.create(i);
+		}
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{ 10 };
+		while (destroyed < 100 && std::chrono::steady_clock::now() < deadline) {
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+		}
+		CHECK(destroyed == 100);
+		CHECK(last_destroyer.load() != std::this_thread::get_id());
+	}
+	CHECK(store.live_objects_approx() == 0);
+}
+
+TEST_CASE("deferred_reclamation_in_segmented_stores", "[reclaim]")
+{
+	destroyed = 0;
+	sos::GrowableObjectStore<Tracked, 16, sos::reclaim::deferred<>> growable(32);
+	sos::ShardedObjectStore<Tracked, 16, sos::reclaim::deferred<>>  sharded(2);
+	sos::VirtualObjectStore<Tracked, 64, sos::reclaim::deferred<>> virt(128);
+	for (int i = 0; i < 10; ++i) {
+		(void)growable.create(i);
+		(void)sharded.create(i);
+		(void)virt.create(i);
+	}
+	CHECK(destroyed == 0);
+	CHECK(growable.collect() == 10);
+	CHECK(sharded.collect() == 10);
+	CHECK(virt.collect() == 10);
+	CHECK(destroyed == 30);
+	CHECK(virt.decommit_idle() == 1);
+}
+
+TEST_CASE("concurrent_release_and_collect", "[reclaim]")
+{
+	destroyed = 0;
+	sos::SharedObjectStore<Tracked, 256, sos::reclaim::deferred<32>> store;
+	std::atomic_bool values_ok{ true };
+	{
+		sos::Reclaimer<decltype(store)> reclaimer(store, std::chrono::microseconds{ 50 });
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; ++t) {
+			threads.emplace_back([&] {
+				for (int i = 0; i < 5000; ++i) {
+					auto h = store.create(i);
+					if (h->value != i) {
+						values_ok = false;
+					}
+				}
+			});
+		}
+		for (auto& t : threads) {
+			t.join();
+		}
+	}
+	CHECK(values_ok);
+	CHECK(destroyed == 20000);
+	CHECK(store.live_objects_approx() == 0);
+}
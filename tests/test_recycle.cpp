@@ -0,0 +1,176 @@
+#include <sos/sos.h>
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mgb;
+
+namespace {
+	struct Session {
+		static inline std::atomic_int constructed{ 0 };
+		static inline std::atomic_int destroyed{ 0 };
+
+		std::string      name;
+		std::vector<int> data;
+
+		explicit Session(std::string n = "")
+			: name(std::move(n))
+		{
+			constructed++;
+		}
+		Session(const Session&) = delete;
+		~Session() { destroyed++; }
+
+		void reset()
+		{
+			name.clear();
+			data.clear();
+		}
+		void reinit(const std::string& n)
+		{
+			if (n == "throw") {
+				throw std::runtime_error("reinit failed");
+			}
+			name = n;
+		}
+	};
+
+	// no members for recycling, uses a specialization of recycle_traits instead
+	struct Buffer {
+		std::vector<char> bytes;
+
+		explicit Buffer(std::size_t size = 0)
+			: bytes(size)
+		{
+		}
+	};
+}
+
+template<>
+struct sos::recycle_traits<Buffer> {
+	static void reset(Buffer& b) noexcept { b.bytes.clear(); }
+	static void reinit(Buffer& b, std::size_t size = 0) { b.bytes.resize(size); }
+};
+
+TEST_CASE("recycled_objects_keep_their_buffers", "[recycle]")
+{
+	Session::constructed = 0;
+	Session::destroyed   = 0;
+	{
+		sos::SharedObjectStore<Session, 4, sos::recycle::reuse> store;
+		const char* name_buffer = nullptr;
+		const int*  data_buffer = nullptr;
+		{
+			auto h = store.create(std::string(100, 'a'));
+			h->data.resize(1000);
+			name_buffer = h->name.data();
+			data_buffer = h->data.data();
+		}
+		for (int i = 0; i < 100; ++i) {
+			auto h = store.create(std::string(50, 'b'));
+			// the free list hands the most recently released slot out first
+			CHECK(h->name == std::string(50, 'b'));
+			CHECK(h->name.data() == name_buffer);
+			CHECK(h->data.empty());
+			CHECK(h->data.capacity() >= 1000);
+			h->data.resize(1000);
+			CHECK(h->data.data() == data_buffer);
+		}
+		CHECK(Session::constructed == 1);
+		CHECK(Session::destroyed == 0);
+		CHECK(store.live_objects_approx() == 0);
+
+		// creates without arguments get the reset object
+		auto h1 = store.create();
+		auto h2 = store.create();
+		CHECK(h1->name.empty());
+		CHECK(Session::constructed == 2);
+	}
+	// kept objects die with the store
+	CHECK(Session::destroyed == Session::constructed);
+}
+
+TEST_CASE("recycle_traits_specialization", "[recycle]")
+{
+	sos::SharedObjectStore<Buffer, 2, sos::recycle::reuse> store;
+	const char* bytes = nullptr;
+	{
+		auto h = store.create();
+		h->bytes.resize(4096);
+		bytes = h->bytes.data();
+	}
+	auto h = store.create(std::size_t{ 16 });
+	CHECK(h->bytes.size() == 16);
+	CHECK(h->bytes.data() == bytes);
+}
+
+TEST_CASE("failed_reinit_gives_slot_back", "[recycle]")
+{
+	Session::constructed = 0;
+	Session::destroyed   = 0;
+	{
+		sos::SharedObjectStore<Session, 1, sos::recycle::reuse> store;
+		{
+			auto h = store.create("first");
+		}
+		CHECK_THROWS_AS(store.create("throw"), std::runtime_error);
+		CHECK(store.live_objects_approx() == 0);
+		auto h = store.create("second");
+		CHECK(h->name == "second");
+		CHECK(Session::constructed == 1);
+	}
+	CHECK(Session::destroyed == 1);
+}
+
+TEST_CASE("recycle_with_deferred_reclamation", "[recycle]")
+{
+	Session::constructed = 0;
+	Session::destroyed   = 0;
+	{
+		sos::SharedObjectStore<Session, 8, sos::recycle::reuse, sos::reclaim::deferred<>> store;
+		{
+			auto h = store.create("a");
+			h->data.resize(10);
+		}
+		CHECK(store.collect() == 1);
+		auto h = store.create("b");
+		CHECK(h->data.empty());
+		CHECK(Session::constructed == 1);
+		CHECK(Session::destroyed == 0);
+	}
+	CHECK(Session::destroyed == 1);
+}
+
+TEST_CASE("recycle_under_concurrent_churn", "[recycle]")
+{
+	Session::constructed = 0;
+	Session::destroyed   = 0;
+	constexpr int thread_cnt = 4;
+	{
+		sos::SharedObjectStore<Session, 64, sos::recycle::reuse, sos::alloc::magazines<>> store;
+		std::atomic_bool         values_ok{ true };
+		std::vector<std::thread> threads;
+		for (int t = 0; t < thread_cnt; ++t) {
+			threads.emplace_back([&store, &values_ok, t] {
+				for (int i = 0; i < 10000; ++i) {
+					auto h    = std::move(store.create(std::to_string(t))).lock();
+					auto copy = h;
+					if (copy->name != std::to_string(t)) {
+						values_ok = false;
+					}
+				}
+			});
+		}
+		for (auto& t : threads) {
+			t.join();
+		}
+		CHECK(values_ok);
+		CHECK(Session::constructed <= 64);
+	}
+	CHECK(Session::destroyed == Session::constructed);
+}
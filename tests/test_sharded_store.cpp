@@ -0,0 +1,58 @@
+#include <sos/sharded_store.h>
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace mgb;
+
+TEST_CASE("sharded_store_steals_when_home_shard_is_full", "[sharded]")
+{
+	sos::ShardedObjectStore<int, 8> store(4);
+	CHECK(store.capacity() == 32);
+
+	std::vector<sos::Handle<int>> handles;
+	for (int i = 0; i < 32; ++i) {
+		handles.push_back(store.create(i));
+	}
+	CHECK(store.live_objects_approx() == 32);
+	CHECK(store.remaining_capacity_approx() == 0);
+	CHECK_THROWS_AS(store.create(0), std::bad_alloc);
+
+	for (int i = 0; i < 32; ++i) {
+		CHECK(*handles[i] == i);
+	}
+	handles.clear();
+	CHECK(store.live_objects_approx() == 0);
+}
+
+TEST_CASE("sharded_store_threads_use_their_home_shard", "[sharded]")
+{
+	sos::ShardedObjectStore<int, 64> store(4, sos::shard_key::cpu);
+	CHECK(store.home_shard() < store.shard_cnt());
+
+	std::atomic_bool values_ok{ true };
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&store, &values_ok] {
+			for (int round = 0; round < 1000; ++round) {
+				std::vector<sos::ConstHandle<int>> handles;
+				for (int i = 0; i < 32; ++i) {
+					handles.push_back(store.create(i).lock());
+				}
+				for (int i = 0; i < 32; ++i) {
+					if (*handles[i] != i) {
+						values_ok = false;
+					}
+				}
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	CHECK(values_ok);
+	CHECK(store.live_objects_approx() == 0);
+}
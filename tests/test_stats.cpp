@@ -0,0 +1,138 @@
+#include <sos/stats.h>
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mgb;
+
+TEST_CASE("stats_count_creates_and_releases", "[stats]")
+{
+	sos::SharedObjectStore<int, 4, sos::stats::counters<>> store;
+	{
+		auto h1 = store.create(1);
+		auto h2 = store.create(2);
+		auto h3 = store.create(3);
+	}
+	auto h = store.create(4);
+
+	const auto stats = store.stats();
+	CHECK(stats.creates == 4);
+	CHECK(stats.releases == 3);
+	CHECK(stats.live == 1);
+	// sampled, so the peak of 3 may be missed
+	CHECK(stats.live_high_water >= 1);
+	CHECK(stats.live_high_water <= 3);
+	CHECK(stats.capacity == 4);
+	CHECK(stats.create_failures == 0);
+	CHECK(stats.bad_allocs == 0);
+}
+
+TEST_CASE("stats_sample_high_water", "[stats]")
+{
+	sos::SharedObjectStore<int, 64, sos::stats::counters<1>> store;
+	std::vector<sos::Handle<int>> handles;
+	for (int i = 0; i < 40; ++i) {
+		handles.push_back(store.create(i));
+	}
+	handles.clear();
+	// sampled on the 1st, 17th and 33rd claim
+	const auto stats = store.stats();
+	CHECK(stats.live == 0);
+	CHECK(stats.live_high_water >= 33);
+	CHECK(stats.live_high_water <= 40);
+}
+
+TEST_CASE("stats_count_full_store", "[stats]")
+{
+	sos::SharedObjectStore<int, 2, sos::stats::counters<4>, sos::alloc::bitmap> store;
+	auto h1 = store.create(1);
+	auto h2 = store.create(2);
+	CHECK(store.try_create(3).empty());
+	CHECK_THROWS_AS(store.create(3), std::bad_alloc);
+	CHECK(store.try_create_for(std::chrono::milliseconds(1), 3).empty());
+
+	const auto stats = store.stats();
+	CHECK(stats.creates == 2);
+	CHECK(stats.bad_allocs == 1);
+	CHECK(stats.yields == 10);
+	CHECK(stats.waits >= 1);
+	// try_create, the 11 attempts of create and at least two of create_wait
+	CHECK(stats.create_failures >= 14);
+	CHECK(stats.scan_steps >= 2);
+	CHECK(stats.live_high_water == 2);
+}
+
+TEST_CASE("stats_count_batches_and_deferred_reclamation", "[stats]")
+{
+	sos::SharedObjectStore<int, 16, sos::stats::counters<>, sos::reclaim::deferred<100>> store;
+	{
+		auto handles = store.create_n(5, [](sos::idx_t i) { return static_cast<int>(i); });
+		CHECK(store.try_create_n(12, [](sos::idx_t i) { return static_cast<int>(i); }).empty());
+		CHECK(store.stats().live == 5);
+	}
+	CHECK(store.collect() == 5);
+
+	const auto stats = store.stats();
+	CHECK(stats.creates == 5);
+	CHECK(stats.create_failures == 1);
+	CHECK(stats.collected == 5);
+	CHECK(stats.live == 0);
+	CHECK(stats.live_high_water == 5); // the failed batch doesn't count
+}
+
+TEST_CASE("stats_aggregate_threads", "[stats]")
+{
+	constexpr int thread_cnt = 4;
+	constexpr int per_thread = 10000;
+	sos::SharedObjectStore<int, 64, sos::stats::counters<2>, sos::alloc::magazines<>> store;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_cnt; ++t) {
+		threads.emplace_back([&] {
+			for (int i = 0; i < per_thread; ++i) {
+				auto h = store.create(i);
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	const auto stats = store.stats();
+	CHECK(stats.creates == thread_cnt * per_thread);
+	CHECK(stats.releases == thread_cnt * per_thread);
+	CHECK(stats.live == 0);
+	CHECK(stats.live_high_water >= 1);
+	CHECK(stats.live_high_water <= thread_cnt);
+}
+
+TEST_CASE("stats_serialization", "[stats]")
+{
+	sos::store_stats stats;
+	stats.creates         = 7;
+	stats.live            = 3;
+	stats.live_high_water = 5;
+	stats.capacity        = 8;
+
+	const auto prom = sos::to_prometheus(stats, "app_sos", "store=\"sessions\"");
+	CHECK(prom.find("# TYPE app_sos_creates_total counter\n") != std::string::npos);
+	CHECK(prom.find("app_sos_creates_total{store=\"sessions\"} 7\n") != std::string::npos);
+	CHECK(prom.find("app_sos_live_objects_high_water{store=\"sessions\"} 5\n") != std::string::npos);
+	CHECK(sos::to_prometheus(stats).find("sos_capacity 8\n") != std::string::npos);
+
+	const auto json = sos::to_json(stats);
+	CHECK(json.front() == '{');
+	CHECK(json.back() == '}');
+	CHECK(json.find("\"creates_total\":7,") != std::string::npos);
+	CHECK(json.find("\"live_objects\":3,") != std::string::npos);
+	CHECK(json.find("\"capacity\":8}") != std::string::npos);
+}
+
+TEST_CASE("stats_disabled_by_default", "[stats]")
+{
+	// the counters of the default policy don't take up any space
+	CHECK(sizeof(sos::SharedObjectStore<int, 64>) < sizeof(sos::SharedObjectStore<int, 64, sos::stats::counters<>>));
+	CHECK(std::is_empty<sos::detail::NoStats>::value);
+}
@@ -0,0 +1,183 @@
+// Part of sos-trace-tests, which is built with SOS_ENABLE_TRACE
+#include <sos/trace.h>
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mgb;
+
+#if !defined(SOS_ENABLE_TRACE)
+#error "test_trace.cpp has to be built with SOS_ENABLE_TRACE"
+#endif
+
+namespace {
+std::size_t count(const std::vector<sos::TraceRecord>& records, sos::trace_event event)
+{
+	return static_cast<std::size_t>(std::count_if(records.begin(), records.end(), [&](const auto& r) { return r.event == event; }));
+}
+} // namespace
+
+TEST_CASE("trace_records_handle_events", "[trace]")
+{
+	const std::string path = "sos_test_trace_events.bin";
+	sos::SharedObjectStore<int, 8> store;
+	auto untraced = store.create(0);
+	{
+		sos::TraceRecorder recorder(path);
+		store.start_trace(recorder);
+		{
+			auto h    = std::move(store.create(1)).lock();
+			auto copy = h;
+			sos::WeakHandle<int> weak(h);
+			CHECK(!weak.lock().empty());
+			copy = decltype(copy){};
+			auto mut = std::move(h).turn_into_modifiable_handle();
+		}
+		store.stop_trace();
+		auto after = store.create(2);
+		recorder.flush();
+		CHECK(recorder.good());
+		CHECK(recorder.dropped() == 0);
+	}
+
+	const auto records = sos::read_trace(path);
+	std::remove(path.c_str());
+
+	REQUIRE(!records.empty());
+	CHECK(records.front().event == sos::trace_event::attach);
+	CHECK(records.front().slot == 8);
+	CHECK(count(records, sos::trace_event::create) == 1);
+	// the handle of create, the copy and the handle of the weak lock
+	CHECK(count(records, sos::trace_event::acquire) == 3);
+	CHECK(count(records, sos::trace_event::release) == 3);
+	CHECK(count(records, sos::trace_event::lock) == 1);
+	CHECK(count(records, sos::trace_event::unlock) == 1);
+	CHECK(std::is_sorted(records.begin(), records.end(), [](const auto& l, const auto& r) { return l.time_ns < r.time_ns; }));
+	for (const auto& r : records) {
+		if (r.event != sos::trace_event::attach) {
+			CHECK(r.slot == records[1].slot);
+			CHECK(r.slot != 0); // slot 0 holds the untraced object
+		}
+	}
+}
+
+TEST_CASE("trace_records_all_threads", "[trace]")
+{
+	const std::string path = "sos_test_trace_threads.bin";
+	constexpr int     thread_cnt = 4;
+	constexpr int     per_thread = 5000; // more than fits into one buffer
+
+	sos::SharedObjectStore<int, 64, sos::alloc::magazines<>> store;
+	{
+		sos::TraceRecorder recorder(path);
+		store.start_trace(recorder);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < thread_cnt; ++t) {
+			threads.emplace_back([&] {
+				for (int i = 0; i < per_thread; ++i) {
+					auto h = store.create(i);
+				}
+			});
+		}
+		for (auto& t : threads) {
+			t.join();
+		}
+		store.stop_trace();
+	}
+
+	const auto records = sos::read_trace(path);
+	std::remove(path.c_str());
+
+	CHECK(records.size() == 1 + 3u * thread_cnt * per_thread);
+	CHECK(count(records, sos::trace_event::create) == static_cast<std::size_t>(thread_cnt * per_thread));
+	std::vector<int> per_id(thread_cnt + 1);
+	for (const auto& r : records) {
+		REQUIRE(r.thread < per_id.size());
+		per_id[r.thread]++;
+	}
+	// the attach event was recorded by the main thread
+	CHECK(std::count(per_id.begin(), per_id.end(), 3 * per_thread) == thread_cnt);
+}
+
+TEST_CASE("trace_split_layout_and_bulk_release", "[trace]")
+{
+	const std::string path = "sos_test_trace_split.bin";
+	sos::SharedObjectStore<int, 16, sos::layout::split<4>> store;
+	{
+		sos::TraceRecorder recorder(path);
+		store.start_trace(recorder);
+		auto handles = store.create_n(3, [](sos::idx_t i) { return static_cast<int>(i); });
+		handles.clear();
+		store.stop_trace();
+	}
+	const auto records = sos::read_trace(path);
+	std::remove(path.c_str());
+
+	CHECK(count(records, sos::trace_event::create) == 3);
+	CHECK(count(records, sos::trace_event::acquire) == 3);
+	CHECK(count(records, sos::trace_event::release) == 3);
+	for (const auto& r : records) {
+		if (r.event != sos::trace_event::attach) {
+			CHECK(r.slot < 3);
+		}
+	}
+}
+
+TEST_CASE("trace_thread_alternating_between_recorders", "[trace]")
+{
+	const std::string path1 = "sos_test_trace_alternate1.bin";
+	const std::string path2 = "sos_test_trace_alternate2.bin";
+	constexpr int     rounds = 1000;
+
+	sos::SharedObjectStore<int, 8> store1;
+	sos::SharedObjectStore<int, 8> store2;
+	// more recorders than a thread remembers, so some lookups have to go through the recorder
+	sos::SharedObjectStore<int, 8> extra[4];
+	{
+		sos::TraceRecorder recorder1(path1);
+		sos::TraceRecorder recorder2(path2);
+		sos::TraceRecorder extra_recorder("sos_test_trace_alternate_extra.bin");
+		store1.start_trace(recorder1);
+		store2.start_trace(recorder2);
+		for (auto& s : extra) {
+			s.start_trace(extra_recorder);
+		}
+		for (int i = 0; i < rounds; ++i) {
+			auto h1 = store1.create(i);
+			auto h2 = store2.create(i);
+			auto h3 = extra[i % 4].create(i);
+		}
+		store1.stop_trace();
+		store2.stop_trace();
+		for (auto& s : extra) {
+			s.stop_trace();
+		}
+	}
+	std::remove("sos_test_trace_alternate_extra.bin");
+	for (const auto& path : { path1, path2 }) {
+		const auto records = sos::read_trace(path);
+		std::remove(path.c_str());
+		CHECK(count(records, sos::trace_event::create) == rounds);
+		// all events came from one thread, which used a single buffer per recorder
+		CHECK(std::all_of(records.begin(), records.end(), [](const auto& r) { return r.thread == 0; }));
+	}
+}
+
+TEST_CASE("read_trace_rejects_other_files", "[trace]")
+{
+	const std::string path = "sos_test_trace_invalid.bin";
+	{
+		std::FILE* f = std::fopen(path.c_str(), "wb");
+		REQUIRE(f != nullptr);
+		std::fputs("definitely not a trace", f);
+		std::fclose(f);
+	}
+	CHECK_THROWS_AS(sos::read_trace(path), std::runtime_error);
+	std::remove(path.c_str());
+	CHECK_THROWS_AS(sos::read_trace(path), std::runtime_error);
+}
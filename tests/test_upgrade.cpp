@@ -0,0 +1,122 @@
+#include <sos/sos.h>
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mgb;
+
+TEST_CASE("try_upgrade_unique_handle_in_place", "[upgrade]")
+{
+	sos::SharedObjectStore<std::string, 8> store;
+	auto        shared = std::move(store.create("hello")).lock();
+	const auto* addr   = &*shared;
+	sos::WeakHandle<std::string> weak(shared);
+
+	auto mut = std::move(shared).try_upgrade();
+	REQUIRE(!mut.empty());
+	CHECK(shared.empty());
+	CHECK(&*mut == addr);
+	CHECK(store.live_objects_approx() == 1);
+	// weak handles don't survive modification
+	CHECK(weak.lock().empty());
+}
+
+TEST_CASE("try_upgrade_shared_handle_fails", "[upgrade]")
+{
+	sos::SharedObjectStore<int, 8> store;
+	auto shared = std::move(store.create(5)).lock();
+	auto copy   = shared;
+
+	auto mut = std::move(shared).try_upgrade();
+	CHECK(mut.empty());
+	// the const handle is left untouched
+	REQUIRE(!shared.empty());
+	CHECK(*shared == 5);
+	CHECK(!shared.unique());
+	CHECK_THROWS_AS(std::move(shared).turn_into_modifiable_handle(), std::runtime_error);
+	CHECK(!shared.empty());
+
+	copy = decltype(copy){};
+	CHECK(!std::move(shared).try_upgrade().empty());
+}
+
+TEST_CASE("make_mutable_clones_shared_objects", "[upgrade]")
+{
+	sos::SharedObjectStore<std::string, 8> store;
+	auto shared = std::move(store.create("hello")).lock();
+	auto copy   = shared;
+
+	auto mut = sos::make_mutable(store, std::move(shared));
+	REQUIRE(!mut.empty());
+	CHECK(shared.empty());
+	CHECK(&*mut != &*copy);
+	*mut += " world";
+	CHECK(*copy == "hello");
+	CHECK(store.live_objects_approx() == 2);
+
+	// the last handle is upgraded without a copy
+	const auto* addr = &*copy;
+	auto        mut2 = sos::make_mutable(store, std::move(copy));
+	CHECK(&*mut2 == addr);
+	CHECK(store.live_objects_approx() == 2);
+}
+
+TEST_CASE("make_mutable_keeps_handle_if_store_is_full", "[upgrade]")
+{
+	sos::SharedObjectStore<int, 1> store;
+	auto shared = std::move(store.create(1)).lock();
+	auto copy   = shared;
+
+	CHECK_THROWS_AS(sos::make_mutable(store, std::move(shared)), std::bad_alloc);
+	REQUIRE(!shared.empty());
+	CHECK(*shared == 1);
+}
+
+TEST_CASE("try_upgrade_with_biased_refcount", "[upgrade]")
+{
+	sos::SharedObjectStore<int, 8, sos::refcount::biased<4>> store;
+	auto shared = std::move(store.create(1)).lock();
+	{
+		// leaves spare references in the cache of this thread
+		auto copy = shared;
+	}
+	auto mut = std::move(shared).try_upgrade();
+	REQUIRE(!mut.empty());
+	CHECK(*mut == 1);
+
+	auto shared2 = std::move(store.create(2)).lock();
+	auto copy    = shared2;
+	CHECK(std::move(shared2).try_upgrade().empty());
+	CHECK(!shared2.empty());
+}
+
+TEST_CASE("try_upgrade_races_with_weak_locks", "[upgrade]")
+{
+	sos::SharedObjectStore<int, 8> store;
+	for (int round = 0; round < 200; ++round) {
+		auto                  shared = std::move(store.create(round)).lock();
+		sos::WeakHandle<int>  weak(shared);
+		std::atomic_bool      go{ false };
+		sos::ConstHandle<int> locked;
+		std::thread           t([&] {
+			while (!go) {
+			}
+			locked = weak.lock();
+		});
+		go = true;
+		auto mut = std::move(shared).try_upgrade();
+		t.join();
+		// exactly one of them wins
+		CHECK(mut.empty() != locked.empty());
+		if (!mut.empty()) {
+			CHECK(*mut == round);
+		} else {
+			CHECK(*locked == round);
+			CHECK(!shared.empty());
+		}
+	}
+}
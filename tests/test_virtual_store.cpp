@@ -0,0 +1,160 @@
+#include <sos/virtual_store.h>
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mgb;
+
+TEST_CASE("virtual_store_commits_segments_on_demand", "[virtual]")
+{
+	sos::VirtualObjectStore<std::string, 64> store(1'000'000);
+	CHECK(store.capacity() == 1'000'000);
+	CHECK(store.committed_capacity() == 0);
+
+	std::vector<sos::ConstHandle<std::string>> handles;
+	for (int i = 0; i < 100; ++i) {
+		handles.push_back(store.create(std::to_string(i)).lock());
+	}
+	CHECK(store.committed_capacity() == 128);
+	CHECK(store.live_objects_approx() == 100);
+	CHECK(store.remaining_capacity_approx() == 1'000'000 - 100);
+	for (int i = 0; i < 100; ++i) {
+		CHECK(*handles[i] == std::to_string(i));
+	}
+}
+
+TEST_CASE("virtual_store_decommits_idle_segments", "[virtual]")
+{
+	sos::VirtualObjectStore<int, 64> store(64 * 4);
+
+	std::vector<sos::Handle<int>> handles;
+	for (int i = 0; i < 64 * 4; ++i) {
+		handles.push_back(store.create(i));
+	}
+	CHECK(store.committed_capacity() == 64 * 4);
+	CHECK_THROWS_AS(store.create(0), std::bad_alloc);
+
+	// free the first two segments and one object of the third
+	handles.erase(handles.begin(), handles.begin() + 129);
+	CHECK(store.decommit_idle(std::chrono::hours{ 1 }) == 0);
+	CHECK(store.decommit_idle() == 2);
+	CHECK(store.committed_capacity() == 64 * 2);
+	CHECK(store.live_objects_approx() == 64 * 4 - 129);
+
+	// decommitted segments are committed again when needed
+	for (int i = 0; i < 129; ++i) {
+		handles.push_back(store.create(i));
+	}
+	CHECK(*handles.back() == 128);
+	CHECK(store.committed_capacity() == 64 * 4);
+	handles.clear();
+	CHECK(store.decommit_idle() == 4);
+	CHECK(store.committed_capacity() == 0);
+}
+
+TEST_CASE("virtual_store_concurrent_decommit", "[virtual]")
+{
+	constexpr int thread_cnt = 3;
+	sos::VirtualObjectStore<int, 16> store(16 * 64);
+
+	std::atomic_bool stop{ false };
+	std::thread trimmer([&] {
+		while (!stop) {
+			store.decommit_idle();
+			std::this_thread::yield();
+		}
+	});
+
+	std::atomic_bool values_ok{ true };
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_cnt; ++t) {
+		threads.emplace_back([&store, &values_ok] {
+			for (int round = 0; round < 200; ++round) {
+				std::vector<sos::Handle<int>> handles;
+				for (int i = 0; i < 40; ++i) {
+					handles.push_back(store.create(i));
+				}
+				for (int i = 0; i < 40; ++i) {
+					if (*handles[i] != i) {
+						values_ok = false;
+					}
+				}
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	stop = true;
+	trimmer.join();
+
+	CHECK(values_ok);
+	CHECK(store.live_objects_approx() == 0);
+	store.decommit_idle();
+	CHECK(store.committed_capacity() == 0);
+}
+
+TEST_CASE("virtual_store_prefault", "[virtual]")
+{
+	sos::memory_options options;
+	options.prefault = true;
+	sos::VirtualObjectStore<int, 64> store(64 * 8, options);
+	CHECK(store.committed_capacity() == 64 * 8);
+	CHECK(store.backing_page_size() == sos::detail::vm::page_size());
+	CHECK_FALSE(store.memory_locked());
+
+	auto h = store.create(5);
+	CHECK(*h == 5);
+}
+
+TEST_CASE("virtual_store_huge_pages_fall_back_gracefully", "[virtual]")
+{
+	for (auto mode : { sos::page_mode::transparent_huge, sos::page_mode::explicit_huge }) {
+		sos::memory_options options;
+		options.pages    = mode;
+		options.prefault = true;
+		// big enough for a huge page per segment
+		sos::VirtualObjectStore<std::int64_t, 1 << 18> store(1 << 19, options);
+		CHECK(store.committed_capacity() == 1 << 19);
+
+		const auto page = store.backing_page_size();
+		CHECK((page == sos::detail::vm::page_size() || page == sos::detail::vm::huge_page_size()));
+
+		std::vector<sos::Handle<std::int64_t>> handles;
+		for (int i = 0; i < 1000; ++i) {
+			handles.push_back(store.create(i));
+		}
+		CHECK(*handles[999] == 999);
+	}
+}
+
+TEST_CASE("virtual_store_locked_memory_is_not_decommitted", "[virtual]")
+{
+	sos::memory_options options;
+	options.lock = true;
+	sos::VirtualObjectStore<int, 64> store(64 * 2, options);
+	{
+		auto h = store.create(1);
+	}
+	CHECK(store.committed_capacity() == 64);
+	CHECK(store.decommit_idle() == 0);
+	CHECK(store.committed_capacity() == 64);
+}
+
+TEST_CASE("virtual_store_throwing_constructor_keeps_segment_decommittable", "[virtual]")
+{
+	struct Throws {
+		Throws() { throw std::runtime_error("ctor"); }
+	};
+	sos::VirtualObjectStore<Throws, 64> store(64);
+	CHECK_THROWS_AS(store.create(), std::runtime_error);
+	CHECK(store.live_objects_approx() == 0);
+	CHECK(store.decommit_idle() == 1);
+	CHECK(store.committed_capacity() == 0);
+}
@@ -0,0 +1,136 @@
+#include <sos/sos.h>
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace mgb;
+
+TEST_CASE("for_each_live_visits_published_objects_only", "[visit]")
+{
+	sos::SharedObjectStore<int, 8> store;
+	auto shared1 = std::move(store.create(1)).lock();
+	auto shared2 = std::move(store.create(2)).lock();
+	auto copy    = shared2;
+	auto mut     = store.create(3);
+	auto shared4 = std::move(store.create(4)).lock();
+	// made modifiable again
+	auto remut = std::move(shared4).turn_into_modifiable_handle();
+
+	std::vector<int> seen;
+	store.for_each_live([&](const int& v) { seen.push_back(v); });
+	std::sort(seen.begin(), seen.end());
+	CHECK(seen == std::vector<int>{ 1, 2 });
+
+	// visiting doesn't leave references behind
+	CHECK(shared1.unique());
+	CHECK(mut.unique());
+
+	auto locked = std::move(mut).lock();
+	seen.clear();
+	store.for_each_live([&](const int& v) { seen.push_back(v); });
+	CHECK(seen.size() == 3);
+}
+
+TEST_CASE("visited_object_stays_alive_during_callback", "[visit]")
+{
+	sos::SharedObjectStore<std::vector<int>, 4, sos::layout::split<4>> store;
+	auto handle = std::move(store.create(3, 7)).lock();
+	store.for_each_live([&](const std::vector<int>& v) {
+		handle = decltype(handle){};
+		// the visitor holds the last reference now
+		CHECK(store.live_objects_approx() == 1);
+		CHECK(v == std::vector<int>{ 7, 7, 7 });
+	});
+	CHECK(store.live_objects_approx() == 0);
+}
+
+TEST_CASE("deferred_objects_are_not_visited", "[visit]")
+{
+	sos::SharedObjectStore<int, 4, sos::reclaim::deferred<8>> store;
+	{
+		auto h = std::move(store.create(1)).lock();
+	}
+	CHECK(store.retired_objects_approx() == 1);
+	int cnt = 0;
+	store.for_each_live([&](const int&) { ++cnt; });
+	CHECK(cnt == 0);
+}
+
+TEST_CASE("snapshot_returns_handles_to_published_objects", "[visit]")
+{
+	sos::SharedObjectStore<int, 16> store;
+	std::vector<decltype(store)::const_handle_type> handles;
+	for (int i = 0; i < 10; ++i) {
+		handles.push_back(std::move(store.create(i)).lock());
+	}
+	auto mut = store.create(100);
+
+	auto snap = store.snapshot();
+	REQUIRE(snap.size() == 10);
+	handles.clear();
+	CHECK(store.live_objects_approx() == 11);
+
+	std::vector<int> values;
+	for (const auto& h : snap) {
+		values.push_back(*h);
+	}
+	std::sort(values.begin(), values.end());
+	CHECK(values == std::vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 });
+	snap.clear();
+	CHECK(store.live_objects_approx() == 1);
+}
+
+TEST_CASE("for_each_live_par_visits_every_object_once", "[visit]")
+{
+	constexpr int cnt = 3000;
+	sos::SharedObjectStore<int, 4096> store;
+	std::vector<decltype(store)::const_handle_type> handles;
+	for (int i = 0; i < cnt; ++i) {
+		handles.push_back(std::move(store.create(i)).lock());
+	}
+
+	std::vector<std::atomic_int> visits(cnt);
+	store.for_each_live_par([&](const int& v) { visits[v]++; }, 4);
+	CHECK(std::all_of(visits.begin(), visits.end(), [](const auto& v) { return v == 1; }));
+
+	CHECK_THROWS_AS(store.for_each_live_par([](const int& v) {
+		if (v == 1234) {
+			throw std::runtime_error("stop");
+		}
+	}, 4), std::runtime_error);
+	CHECK(handles.front().unique());
+}
+
+TEST_CASE("for_each_live_with_concurrent_churn", "[visit]")
+{
+	sos::SharedObjectStore<int, 256> store;
+	std::vector<decltype(store)::const_handle_type> stable;
+	for (int i = 0; i < 64; ++i) {
+		stable.push_back(std::move(store.create(-1)).lock());
+	}
+	std::atomic_bool stop{ false };
+	std::thread churn([&] {
+		while (!stop) {
+			auto h = store.create(1);
+			*h     = 2;
+			auto c = std::move(h).lock();
+		}
+	});
+	for (int round = 0; round < 200; ++round) {
+		int negative = 0;
+		store.for_each_live([&](const int& v) {
+			// a modifiable handle only ever writes before publishing
+			CHECK(v != 1);
+			negative += v == -1;
+		});
+		CHECK(negative == 64);
+	}
+	stop = true;
+	churn.join();
+}
@@ -0,0 +1,98 @@
+#include <sos/sos.h>
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mgb;
+
+TEST_CASE("weak_handle_does_not_keep_object_alive", "[weak]")
+{
+	sos::SharedObjectStore<std::string, 4> store;
+	auto handle = std::move(store.create("hello")).lock();
+	sos::WeakHandle<std::string> weak(handle);
+	CHECK(!weak.expired());
+	CHECK(store.live_objects_approx() == 1);
+
+	{
+		auto locked = weak.lock();
+		REQUIRE(!locked.empty());
+		CHECK(*locked == "hello");
+		CHECK(!handle.unique());
+	}
+	CHECK(handle.unique());
+
+	handle = decltype(handle){};
+	CHECK(store.live_objects_approx() == 0);
+	CHECK(weak.expired());
+	CHECK(weak.lock().empty());
+
+	CHECK(sos::WeakHandle<std::string>{}.lock().empty());
+}
+
+TEST_CASE("weak_handle_detects_reused_slot", "[weak]")
+{
+	sos::SharedObjectStore<int, 1, sos::layout::split<4>> store;
+	decltype(store)::weak_handle_type weak;
+	{
+		auto first = std::move(store.create(1)).lock();
+		weak       = first;
+	}
+	auto second = std::move(store.create(2)).lock();
+	CHECK(weak.expired());
+	CHECK(weak.lock().empty());
+	CHECK(second.unique());
+}
+
+TEST_CASE("weak_handle_is_invalidated_by_modifiable_handle", "[weak]")
+{
+	sos::SharedObjectStore<int, 4> store;
+	auto handle = std::move(store.create(1)).lock();
+	sos::WeakHandle<int> weak(handle);
+
+	auto mutable_handle = std::move(handle).turn_into_modifiable_handle();
+	*mutable_handle = 2;
+	CHECK(weak.lock().empty());
+
+	handle = std::move(mutable_handle).lock();
+	CHECK(weak.lock().empty());
+	sos::WeakHandle<int> fresh(handle);
+	CHECK(*fresh.lock() == 2);
+}
+
+TEST_CASE("weak_handle_lock_races_with_release", "[weak]")
+{
+	sos::SharedObjectStore<int, 8> store;
+	std::atomic_bool values_ok{ true };
+	std::atomic_bool done{ false };
+	std::vector<sos::WeakHandle<int>> weaks(8);
+	std::vector<sos::ConstHandle<int>> strong(8);
+	for (std::size_t i = 0; i < 8; ++i) {
+		strong[i] = std::move(store.create(static_cast<int>(i))).lock();
+		weaks[i]  = strong[i];
+	}
+	std::thread reader([&] {
+		while (!done) {
+			for (std::size_t i = 0; i < 8; ++i) {
+				auto h = weaks[i].lock();
+				if (!h.empty() && *h != static_cast<int>(i)) {
+					values_ok = false;
+				}
+			}
+		}
+	});
+	for (int round = 0; round < 2000; ++round) {
+		const auto i = static_cast<std::size_t>(round % 8);
+		strong[i]    = sos::ConstHandle<int>{};
+		// the slot gets reused for a different value, which no old weak handle may observe
+		strong[i] = std::move(store.create(100 + round)).lock();
+	}
+	done = true;
+	reader.join();
+	CHECK(values_ok);
+	strong.clear();
+	CHECK(store.live_objects_approx() == 0);
+}
@@ -0,0 +1,288 @@
+/*
+ * sos-replay: drives a SharedObjectStore with the events of a trace file (see sos/trace.h) and reports the throughput,
+ * the latency percentiles per operation and the peak occupancy, e.g. to pick Size and the allocation policy.
+ *
+ * usage: sos-replay <trace file> [--capacity=<slots>] [--alloc=free_list|magazines|bitmap|all]
+ *
+ * The capacity defaults to the one of the traced store and is rounded up to a power of two (2^8 .. 2^20).
+ * The events of all threads are replayed in time order on a single thread, with 64 byte objects. That keeps handles
+ * passed between threads valid, but means the replay doesn't show contention: It compares the policies under the traced
+ * occupancy and reuse pattern, sos-bench compares them under concurrent load.
+ */
+#include <sos/trace.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace mgb;
+
+namespace {
+
+constexpr int min_capacity_log2 = 8;
+constexpr int max_capacity_log2 = 20;
+
+struct Object {
+	std::array<std::uint64_t, 8> data{};
+};
+
+constexpr std::size_t event_kinds = static_cast<std::size_t>(sos::trace_event::unlock) + 1;
+
+const char* name(sos::trace_event event)
+{
+	switch (event) {
+		case sos::trace_event::attach: return "attach";
+		case sos::trace_event::create: return "create";
+		case sos::trace_event::acquire: return "acquire";
+		case sos::trace_event::release: return "release";
+		case sos::trace_event::lock: return "lock";
+		case sos::trace_event::unlock: return "unlock";
+	}
+	return "unknown";
+}
+
+struct Report {
+	std::string                                         alloc;
+	sos::idx_t                                          capacity = 0;
+	double                                              seconds  = 0;
+	std::size_t                                         replayed = 0;
+	std::size_t                                         skipped  = 0; // events of objects the replay doesn't know (or couldn't create)
+	std::size_t                                         failed   = 0; // creates that found the store full
+	sos::idx_t                                          peak     = 0;
+	std::array<std::vector<std::uint32_t>, event_kinds> latencies;    // in ns, by event
+};
+
+// The objects of the traced store, by slot index: the modifiable handle (if any) and the const handles
+template<class Store>
+struct Traced {
+	typename Store::handle_type                    mut;
+	std::vector<typename Store::const_handle_type> shared;
+	bool                                           fresh = false; // the next acquire is the one of create itself
+	bool                                           live  = false;
+};
+
+template<class Store>
+Report replay(const std::vector<sos::TraceRecord>& records, const std::string& alloc)
+{
+	using clock = std::chrono::steady_clock;
+
+	auto   store = std::make_unique<Store>();
+	Report report;
+	report.alloc    = alloc;
+	report.capacity = store->capacity();
+
+	std::uint32_t max_slot = 0;
+	for (const auto& r : records) {
+		if (r.event != sos::trace_event::attach) {
+			max_slot = std::max(max_slot, r.slot);
+		}
+	}
+	std::vector<Traced<Store>> objects(static_cast<std::size_t>(max_slot) + 1);
+	sos::idx_t                 live = 0;
+
+	const auto start = clock::now();
+	for (const auto& r : records) {
+		if (r.event == sos::trace_event::attach) {
+			continue;
+		}
+		auto&      obj = objects[r.slot];
+		const auto t0  = clock::now();
+		bool       ok  = true;
+		switch (r.event) {
+			case sos::trace_event::create:
+				if (obj.live) {
+					// the releases of the previous object in this slot were not recorded
+					live--;
+				}
+				obj       = Traced<Store>{};
+				obj.mut   = store->try_create();
+				obj.fresh = obj.live = !obj.mut.empty();
+				if (obj.live) {
+					report.peak = std::max(report.peak, ++live);
+				} else {
+					report.failed++;
+				}
+				break;
+			case sos::trace_event::acquire:
+				if (obj.fresh) {
+					obj.fresh = false;
+				} else if (!obj.shared.empty()) {
+					obj.shared.push_back(obj.shared.back());
+				} else {
+					ok = false;
+				}
+				break;
+			case sos::trace_event::release:
+				if (!obj.shared.empty()) {
+					obj.shared.pop_back();
+				} else if (!obj.mut.empty()) {
+					obj.mut = typename Store::handle_type{};
+				} else {
+					ok = false;
+				}
+				if (ok && obj.shared.empty() && obj.mut.empty()) {
+					obj.live = false;
+					live--;
+				}
+				break;
+			case sos::trace_event::lock:
+				if (!obj.mut.empty()) {
+					obj.shared.push_back(std::move(obj.mut).lock());
+				} else {
+					ok = false;
+				}
+				break;
+			case sos::trace_event::unlock:
+				if (obj.shared.size() == 1 && obj.shared.back().unique()) {
+					obj.mut = std::move(obj.shared.back()).turn_into_modifiable_handle();
+					obj.shared.pop_back();
+				} else {
+					ok = false;
+				}
+				break;
+			default: ok = false;
+		}
+		const auto t1 = clock::now();
+		if (ok) {
+			report.replayed++;
+			report.latencies[static_cast<std::size_t>(r.event)].push_back(
+				static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()));
+		} else {
+			report.skipped++;
+		}
+	}
+	report.seconds = std::chrono::duration<double>(clock::now() - start).count();
+	objects.clear();
+	return report;
+}
+
+template<int Log2, class Alloc>
+Report replay_sized(const std::vector<sos::TraceRecord>& records, int capacity_log2, const std::string& alloc)
+{
+	if constexpr (Log2 > max_capacity_log2) {
+		(void)records;
+		(void)capacity_log2;
+		(void)alloc;
+		std::abort();
+	} else if (Log2 == capacity_log2) {
+		return replay<sos::SharedObjectStore<Object, sos::idx_t{ 1 } << Log2, Alloc>>(records, alloc);
+	} else {
+		return replay_sized<Log2 + 1, Alloc>(records, capacity_log2, alloc);
+	}
+}
+
+Report run(const std::vector<sos::TraceRecord>& records, int capacity_log2, const std::string& alloc)
+{
+	if (alloc == "magazines") {
+		return replay_sized<min_capacity_log2, sos::alloc::magazines<>>(records, capacity_log2, alloc);
+	}
+	if (alloc == "bitmap") {
+		return replay_sized<min_capacity_log2, sos::alloc::bitmap>(records, capacity_log2, alloc);
+	}
+	return replay_sized<min_capacity_log2, sos::alloc::free_list>(records, capacity_log2, alloc);
+}
+
+std::uint32_t percentile(const std::vector<std::uint32_t>& sorted, double p)
+{
+	if (sorted.empty()) {
+		return 0;
+	}
+	const auto idx = static_cast<std::size_t>(p / 100.0 * static_cast<double>(sorted.size() - 1) + 0.5);
+	return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+void print(Report& report)
+{
+	std::cout << "\nalloc=" << report.alloc << " capacity=" << report.capacity << '\n';
+	std::cout << "  replayed " << report.replayed << " events in " << std::fixed << std::setprecision(3) << report.seconds
+			  << " s (" << std::setprecision(2) << static_cast<double>(report.replayed) / report.seconds / 1e6
+			  << " Mevents/s), skipped " << report.skipped << '\n';
+	std::cout << "  peak occupancy " << report.peak << " (" << std::setprecision(1)
+			  << 100.0 * static_cast<double>(report.peak) / static_cast<double>(report.capacity) << "%), failed creates "
+			  << report.failed << '\n';
+	std::cout << "  " << std::left << std::setw(10) << "op" << std::right << std::setw(12) << "count" << std::setw(10)
+			  << "p50[ns]" << std::setw(10) << "p90" << std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(10)
+			  << "max" << '\n';
+	for (std::size_t e = 1; e < event_kinds; ++e) {
+		auto& lat = report.latencies[e];
+		if (lat.empty()) {
+			continue;
+		}
+		std::sort(lat.begin(), lat.end());
+		std::cout << "  " << std::left << std::setw(10) << name(static_cast<sos::trace_event>(e)) << std::right
+				  << std::setw(12) << lat.size() << std::setw(10) << percentile(lat, 50) << std::setw(10)
+				  << percentile(lat, 90) << std::setw(10) << percentile(lat, 99) << std::setw(10)
+				  << percentile(lat, 99.9) << std::setw(10) << lat.back() << '\n';
+	}
+}
+
+int usage()
+{
+	std::cerr << "usage: sos-replay <trace file> [--capacity=<slots>] [--alloc=free_list|magazines|bitmap|all]\n";
+	return 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		return usage();
+	}
+	const std::string path  = argv[1];
+	long long         slots = 0;
+	std::string       alloc = "all";
+	for (int i = 2; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg.rfind("--capacity=", 0) == 0) {
+			slots = std::atoll(arg.c_str() + 11);
+		} else if (arg.rfind("--alloc=", 0) == 0) {
+			alloc = arg.substr(8);
+		} else {
+			return usage();
+		}
+	}
+	if (alloc != "all" && alloc != "free_list" && alloc != "magazines" && alloc != "bitmap") {
+		return usage();
+	}
+
+	std::vector<sos::TraceRecord> records;
+	try {
+		records = sos::read_trace(path);
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+
+	std::size_t threads = 0;
+	for (const auto& r : records) {
+		if (slots == 0 && r.event == sos::trace_event::attach) {
+			slots = r.slot;
+		}
+		threads = std::max<std::size_t>(threads, r.thread + 1u);
+	}
+	int capacity_log2 = min_capacity_log2;
+	while (capacity_log2 < max_capacity_log2 && (1ll << capacity_log2) < slots) {
+		capacity_log2++;
+	}
+	std::cout << path << ": " << records.size() << " events from " << threads << " threads";
+	if (!records.empty()) {
+		std::cout << " over " << std::fixed << std::setprecision(3) << static_cast<double>(records.back().time_ns) / 1e9 << " s";
+	}
+	std::cout << '\n';
+
+	for (const char* a : { "free_list", "magazines", "bitmap" }) {
+		if (alloc == "all" || alloc == a) {
+			auto report = run(records, capacity_log2, a);
+			print(report);
+		}
+	}
+}